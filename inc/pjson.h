@@ -22,33 +22,25 @@
 
 #include <string.h>
 #include <stdint.h>
-#include <wchar.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef struct {
-    /* buffer used for forming some tokens (e.g. chunks boundaries) */
-    char *buf;
-    char *buf_end;
-    char *buf_ptr; /* next free buf */
-    const char *buf_last; /* last incomplete token */
-
-    /* currently processing chunk */
-    const char *chunk;
-    const char *chunk_end;
-
-    int state, state0; /* current and saved state */
-    const char *ptr; /* current position withing chunk */
+/* max nesting of arrays and maps */
+#ifndef PJ_MAX_DEPTH
+#define PJ_MAX_DEPTH 1024
+#endif
 
-    union {
-        struct {
-            uint32_t c; /* may contain surrogate pair */
-            mbstate_t s;
-        } str;
-    };
-} pj_parser, *pj_parser_ref;
+/* digits of number collected while scanning it */
+struct pj_num_state {
+    uint64_t mant; /* significant digits accumulated so far */
+    int32_t exp10; /* decimal exponent of mant */
+    int32_t exp; /* explicit exponent */
+    uint8_t digits; /* significant digits in mant */
+    uint8_t neg, exp_neg;
+    uint8_t inexact; /* non-zero digits didn't fit into mant */
+};
 
 typedef enum {
     /* terminal tokens */
@@ -63,15 +55,178 @@ typedef enum {
     PJ_TOK_STR,
     PJ_TOK_NUM,
     PJ_TOK_MAP, PJ_TOK_KEY, PJ_TOK_MAP_E,
-    PJ_TOK_ARR, PJ_TOK_ARR_E
+    PJ_TOK_ARR, PJ_TOK_ARR_E,
+    PJ_TOK_STR_PART /* leading fragment of string (see PJ_OPT_STR_PARTS) */
 } pj_token_type;
 
+/* token flags */
+enum {
+    PJ_NUM_INT = 0x1, /* integer value of number is in val.i */
+    PJ_NUM_OVERFLOW = 0x2, /* integer doesn't fit into int64_t (val.i is
+                              saturated unless PJ_NUM_DOUBLE is set) */
+    PJ_NUM_DOUBLE = 0x4, /* value of number is in val.d */
+    PJ_STR_KEY = 0x8, /* string is a key, val.key is its id (only with
+                         dictionary of keys) */
+    PJ_STR_ESC = 0x10 /* str is raw slice with escapes, see pj_unescape()
+                         (only with PJ_OPT_RAW_STR) */
+};
+
 typedef struct {
     pj_token_type token_type;
+    uint16_t flags; /* PJ_NUM_* */
+    uint16_t depth; /* nesting level of token (0 for top-level values and
+                       for brackets of top-level containers) */
     const char *str;
     size_t len;
+    union {
+        int64_t i;
+        double d;
+        int key; /* id of key or -1 (see pj_set_keys()) */
+    } val; /* decoded value (see flags) */
 } pj_token;
 
+/* compact token (see pj_poll_compact()) */
+typedef struct {
+    uint32_t offset; /* of str from start of chunk or from start of buffer
+                        (PJ_CTOK_BUF), required buffer size for PJ_OVERFLOW */
+    uint32_t info; /* len << 8 | PJ_CTOK_BUF | pj_token_type */
+} pj_ctoken;
+
+#define PJ_CTOK_BUF 0x80 /* str is in supplementary buffer */
+#define PJ_CTOK_LONG 0x7f /* terminal: next token doesn't fit, take it with pj_poll() */
+#define PJ_CTOK_TYPE_MASK 0x7f
+#define PJ_CTOK_LEN_MAX 0xffffff
+
+#define PJ_CTOK_TYPE(ctoken) ((int)((ctoken)->info & PJ_CTOK_TYPE_MASK))
+#define PJ_CTOK_LEN(ctoken) ((size_t)((ctoken)->info >> 8))
+#define PJ_CTOK_STR(parser, ctoken) \
+    ((((ctoken)->info & PJ_CTOK_BUF) ? (const char *)(parser)->buf : (parser)->chunk_start) + \
+     (ctoken)->offset)
+
+/* tokens as parallel arrays (see pj_poll_soa()) */
+#define PJ_SOA_BUF 0x80000000U /* flag in lens: str is in supplementary buffer */
+#define PJ_SOA_LEN(lens, i) ((size_t)((lens)[i] & ~PJ_SOA_BUF))
+#define PJ_SOA_STR(parser, offsets, lens, i) \
+    ((((lens)[i] & PJ_SOA_BUF) ? (const char *)(parser)->buf : (parser)->chunk_start) + \
+     (offsets)[i])
+
+/* limits of path projection (see pj_set_projection()) */
+#define PJ_PROJECTION_PATHS 32
+#define PJ_PROJECTION_DEPTH 16
+
+typedef struct {
+    const char * const *paths;
+    /* offsets of path components (after each '/') and of path end + 1 */
+    uint16_t comps[PJ_PROJECTION_PATHS][PJ_PROJECTION_DEPTH + 1];
+    uint8_t ncomps[PJ_PROJECTION_PATHS];
+    uint32_t all; /* bit per path */
+
+    /* paths that still match children of container on each depth */
+    uint32_t sets[PJ_PROJECTION_DEPTH + 1];
+    uint32_t key_set; /* paths matching last key */
+    unsigned pass; /* depth + 1 of selected value being passed through */
+} pj_projection;
+
+/* limits of key dictionary (see pj_set_keys()) */
+#define PJ_KEYS_MAX 64
+#define PJ_KEYS_SLOTS 128
+
+typedef struct {
+    const char * const *keys;
+    uint64_t heads[PJ_KEYS_MAX], tails[PJ_KEYS_MAX]; /* first/last words */
+    uint16_t lens[PJ_KEYS_MAX];
+    uint16_t disp[PJ_KEYS_MAX]; /* displacement of each hash bucket */
+    uint8_t slots[PJ_KEYS_SLOTS]; /* key id + 1 or 0 for free slot */
+} pj_keys;
+
+/* allocator of supplementary buffer (see pj_init_alloc()) */
+typedef struct {
+    void *(*alloc)(void *ctx, size_t len); /* NULL on failure */
+    void (*free)(void *ctx, void *block);
+    void *ctx;
+} pj_allocator;
+
+/* pool of equal blocks shared by many parsers (see pj_init_pool()) */
+typedef struct {
+    void *free; /* list of free blocks */
+    size_t block_len;
+    size_t nfree; /* blocks in list */
+} pj_pool;
+
+typedef struct {
+    /* buffer used for forming some tokens (e.g. chunks boundaries) */
+    char *buf;
+    char *buf_end;
+    char *buf_ptr; /* next free buf */
+    const char *buf_last; /* last incomplete token */
+    const pj_allocator *alloc; /* owner of buf (NULL if it's caller's) */
+    pj_pool *pool; /* lender of buf while it holds incomplete token */
+
+    /* currently processing chunk */
+    const char *chunk;
+    const char *chunk_end;
+    const char *chunk_start; /* as it was fed */
+    const char *chunk_pad; /* end of readable memory (see pj_feed_padded()) */
+
+    int state, state0; /* current and saved state */
+    const char *ptr; /* current position withing chunk */
+
+    int options; /* PJ_OPT_* */
+
+    /* nesting stack: bit per level, set for maps and cleared for arrays */
+    uint64_t nest[(PJ_MAX_DEPTH + 63) / 64];
+    unsigned depth;
+
+    pj_projection *proj; /* optional filter of tokens */
+
+    const pj_keys *keys; /* optional dictionary of keys */
+    int key; /* id of last key */
+    const char *key_str; /* last key (see PJ_OPT_FUSED_KEY) */
+    size_t key_len;
+
+    pj_token held; /* didn't fit into pj_ctoken (PJ_END if none) */
+
+    union {
+        struct {
+            uint32_t c; /* may contain surrogate pair */
+            uint8_t tail_len; /* bytes of UTF-8 char cut by the end of chunk */
+            char tail[3]; /* (see PJ_OPT_UTF8) */
+        } str;
+        struct pj_num_state num;
+        struct {
+            unsigned depth; /* nesting inside of skipped value */
+            uint8_t started; /* met first char of value */
+            uint8_t from; /* state where skipping started */
+        } skip;
+    };
+} pj_parser, *pj_parser_ref;
+
+/* parser options */
+enum {
+    PJ_OPT_NUM_INT = 0x1, /* decode integers while scanning PJ_TOK_NUM */
+    PJ_OPT_NUM_DOUBLE = 0x2, /* decode numbers into double (integers too unless
+                                PJ_OPT_NUM_INT is set and they fit int64_t) */
+    PJ_OPT_FUSED_KEY = 0x4, /* PJ_TOK_KEY carries key in str/len instead of
+                               separate PJ_TOK_STR before it */
+    PJ_OPT_CONTIGUOUS = 0x8, /* input fed so far stays valid and chunk with
+                                continuation of incomplete token starts right
+                                at the end of previous one (mmap, big ring
+                                buffer); tokens spanning chunks point into
+                                input and buffer is used only for unescaping */
+    PJ_OPT_STR_PARTS = 0x10, /* string value cut by the end of chunk is handed
+                                out by pieces: PJ_TOK_STR_PART for what's
+                                decoded so far and PJ_TOK_STR with the rest
+                                once it's complete (keys aren't split), so
+                                buffer holds one decoded chunk at most */
+    PJ_OPT_RAW_STR = 0x20, /* string values with escapes are handed out as
+                              is with PJ_STR_ESC flag instead of being
+                              unescaped (keys are unescaped as usual);
+                              escapes are validated only by pj_unescape() */
+    PJ_OPT_UTF8 = 0x40 /* strings and keys must be valid UTF-8 (PJ_ERR
+                          otherwise); char may be split between pieces of
+                          PJ_OPT_STR_PARTS, skipped values aren't checked */
+};
+
 static void pj_init(pj_parser_ref parser, char *buf, size_t buf_len)
 {
     memset(parser, 0, sizeof(*parser));
@@ -81,14 +236,128 @@ static void pj_init(pj_parser_ref parser, char *buf, size_t buf_len)
     parser->buf_last = buf;
 }
 
-/* notify about re-allocated supplementary buffer */
+/* same as pj_init() but supplementary buffer is allocated and grown by
+ * parser itself with alloc (which should outlive parser), so PJ_OVERFLOW
+ * is reported only if alloc() fails (poll again to retry); tokens stay valid
+ * till next poll as usual
+ */
+void pj_init_alloc(pj_parser_ref parser, const pj_allocator *alloc);
+
+/* split slab of len bytes into blocks of block_len for pj_init_pool()
+ * (pool isn't thread-safe, share it between parsers of one thread)
+ */
+void pj_pool_init(pj_pool *pool, void *slab, size_t len, size_t block_len);
+
+/* same as pj_init() but supplementary buffer is borrowed from pool only
+ * while parser has incomplete (or escaped) token and it goes back on poll
+ * after token is complete, so idle parsers hold no memory; PJ_OVERFLOW is
+ * reported if pool is empty (poll again to retry) or token doesn't fit
+ * into block
+ */
+void pj_init_pool(pj_parser_ref parser, pj_pool *pool);
+
+/* free buffer allocated for parser initialized with pj_init_alloc() (or
+ * return one borrowed from pool)
+ */
+void pj_done(pj_parser_ref parser);
+
+/* enable/disable optional features (PJ_OPT_*) */
+void pj_set_options(pj_parser_ref parser, int options);
+
+/* skip next value (scalar or whole array/map) on following pj_poll() calls
+ * without emitting its tokens and without any unescaping or copying; skipped
+ * value isn't validated beyond brackets and quotes matching
+ * returns 0 or -1 if parser isn't at position of value (it is right after
+ * PJ_TOK_KEY, PJ_TOK_ARR, ',' or at the start)
+ */
+int pj_skip_value(pj_parser_ref parser);
+
+/* return from pj_poll() only tokens of values under given paths (e.g.
+ * "/user/id") together with their keys and brackets of containers on the
+ * way to them; component "*" matches any key or any array item and path ""
+ * selects whole document; everything else is skipped as with
+ * pj_skip_value() (scalars that show up where container is expected are
+ * kept); paths should outlive parser
+ * returns -1 if there are too many paths or some of them is too deep or
+ * doesn't start with '/' (proj == NULL disables projection)
+ */
+int pj_set_projection(pj_parser_ref parser, pj_projection *proj,
+                      const char * const *paths, size_t n);
+
+/* register keys expected in maps: strings that turn out to be keys get
+ * PJ_STR_KEY flag and index of key in names as val.key (-1 for any other
+ * key), PJ_TOK_KEY that follows gets the same val.key; names should outlive
+ * parser
+ * returns -1 if there are more than PJ_KEYS_MAX names, duplicates or no
+ * perfect hash found for them (keys == NULL disables dictionary)
+ */
+int pj_set_keys(pj_parser_ref parser, pj_keys *keys,
+                const char * const *names, size_t n);
+
+/* notify about re-allocated supplementary buffer (not for pj_init_alloc() or
+ * pj_init_pool()) */
 void pj_realloc(pj_parser_ref parser, char *buf, size_t buf_len);
 
 void pj_feed(pj_parser_ref parser, const char *chunk, size_t len);
 void pj_feed_end(pj_parser_ref parser);
 
+/* readable bytes after chunk fed with pj_feed_padded() */
+#define PJ_PADDING 64
+
+/* same as pj_feed() but caller guarantees that PJ_PADDING bytes after chunk
+ * can be read (their contents don't matter and are never taken as input),
+ * so lexer scans till the end of chunk by whole blocks without byte by byte
+ * tails
+ */
+void pj_feed_padded(pj_parser_ref parser, const char *chunk, size_t len);
+
 void pj_poll(pj_parser_ref parser, pj_token *tokens, size_t len);
 
+/* same as pj_poll() but returns number of normal tokens put into tokens
+ * and puts terminal token (PJ_STARVING, PJ_END, PJ_ERR or PJ_OVERFLOW) into
+ * terminal; if all len tokens are normal ones terminal isn't touched and
+ * queue should be polled again
+ */
+size_t pj_poll_n(pj_parser_ref parser, pj_token *tokens, size_t len, pj_token *terminal);
+
+/* parse whole document doc (pj_feed() and pj_feed_end() at once) into
+ * tokens with lexer specialized for input that never continues in another
+ * chunk; tokens are the same as pj_poll() would give
+ * returns number of normal tokens (terminal one follows them if less than
+ * len); if all len tokens are normal ones call it again with doc == NULL to
+ * continue (after pj_realloc() too)
+ */
+size_t pj_parse_buffer(pj_parser_ref parser, const char *doc, size_t doc_len, pj_token *tokens, size_t len);
+
+/* same as pj_poll() but fills 8 bytes tokens with str as offset and without
+ * depth, flags and val; str of token is PJ_CTOK_STR(parser, ctoken) and it
+ * is valid as long as it would be with pj_poll() (resolve tokens in buffer
+ * before pj_realloc()); token with str or len that doesn't fit (or with
+ * PJ_STR_ESC flag) stops queue with PJ_CTOK_LONG and should be taken with
+ * following pj_poll()
+ * returns number of normal tokens (terminal one follows them if less than
+ * len)
+ */
+size_t pj_poll_compact(pj_parser_ref parser, pj_ctoken *tokens, size_t len);
+
+/* same as pj_poll_compact() but tokens are split into parallel arrays of
+ * types (pj_token_type or PJ_CTOK_LONG as is, to be scanned with SIMD),
+ * offsets and lens (with PJ_SOA_BUF flag); use PJ_SOA_STR() and
+ * PJ_SOA_LEN() for str and len of token i
+ */
+size_t pj_poll_soa(pj_parser_ref parser, uint8_t *types, uint32_t *offsets, uint32_t *lens, size_t len);
+
+/* decode escapes of raw string (PJ_STR_ESC) into out of out_len bytes the
+ * same way as parser does it (unicode escapes are encoded as UTF-8);
+ * out_len of len is always enough
+ * returns length of decoded string (only what fits into out is written) or
+ * (size_t)-1 for invalid escape
+ */
+size_t pj_unescape(const char *str, size_t len, char *out, size_t out_len);
+
+/* correctly rounded value of PJ_TOK_NUM token (locale independent) */
+double pj_token_to_double(const pj_token *token);
+
 #ifdef __cplusplus
 }
 #endif
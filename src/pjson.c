@@ -24,26 +24,176 @@
 
 #include "pjson_state.h"
 #include "pjson_general.h"
+#include "pjson_keys.h"
+#include "pjson_doc.h"
 #include "pjson_debug.h"
 
-/* API */
-void pj_feed(pj_parser_ref parser, const char *chunk, size_t len)
+/* chunk followed by pad readable bytes */
+static void pj_feed_chunk(pj_parser_ref parser, const char *chunk, size_t len, size_t pad)
 {
-    TRACE_FUNC();
     assert( parser != NULL );
     assert( len == 0 || chunk != NULL );
-    assert( parser->chunk == NULL || parser->chunk == parser->chunk_end );
     assert( !pj_use_buf(parser) || (parser->buf <= parser->buf_last && parser->buf_last <= parser->buf_ptr) );
 
     if ( parser->chunk != NULL && parser->chunk != parser->chunk_end )
     {
-        parser->state = S_ERR;
-        return;
+        /* incomplete token left in input (PJ_OPT_CONTIGUOUS) continues
+         * right at the end of previous chunk
+         */
+        if (!(parser->options & PJ_OPT_CONTIGUOUS) || parser->ptr != parser->chunk_end ||
+            (len > 0 && chunk != parser->chunk_end))
+        {
+            parser->state = S_ERR;
+            return;
+        }
+        chunk = parser->chunk_end;
+    }
+    else
+    {
+        parser->chunk = chunk;
     }
 
-    parser->chunk = chunk;
+    parser->chunk_start = chunk;
     parser->ptr = chunk;
     parser->chunk_end = chunk + len;
+    parser->chunk_pad = parser->chunk_end + pad;
+}
+
+/* API */
+void pj_feed(pj_parser_ref parser, const char *chunk, size_t len)
+{
+    TRACE_FUNC();
+    pj_feed_chunk(parser, chunk, len, 0);
+}
+
+void pj_feed_padded(pj_parser_ref parser, const char *chunk, size_t len)
+{
+    TRACE_FUNC();
+    pj_feed_chunk(parser, chunk, len, PJ_PADDING);
+}
+
+void pj_init_alloc(pj_parser_ref parser, const pj_allocator *alloc)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( alloc != NULL && alloc->alloc != NULL && alloc->free != NULL );
+
+    pj_init(parser, NULL, 0);
+    parser->alloc = alloc;
+}
+
+void pj_pool_init(pj_pool *pool, void *slab, size_t len, size_t block_len)
+{
+    TRACE_FUNC();
+    assert( pool != NULL );
+    assert( block_len >= sizeof(void *) );
+
+    pool->free = NULL;
+    pool->block_len = block_len;
+    pool->nfree = 0;
+    for (size_t i = len / block_len; i > 0; --i)
+    {
+        char * const block = (char *)slab + (i - 1) * block_len;
+        (void) memcpy(block, &pool->free, sizeof(pool->free));
+        pool->free = block;
+        ++pool->nfree;
+    }
+}
+
+void pj_init_pool(pj_parser_ref parser, pj_pool *pool)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( pool != NULL );
+
+    pj_init(parser, NULL, 0);
+    parser->pool = pool;
+}
+
+/* free blocks left from previous growths of buffer */
+static void pj_free_prev(pj_parser_ref parser)
+{
+    const pj_allocator * const alloc = parser->alloc;
+    void *block, *prev = NULL;
+
+    if (parser->buf == NULL) return;
+    (void) memcpy(&block, parser->buf - PJ_BUF_HEAD, sizeof(block));
+    (void) memcpy(parser->buf - PJ_BUF_HEAD, &prev, sizeof(prev));
+    while (block != NULL)
+    {
+        (void) memcpy(&prev, block, sizeof(prev));
+        alloc->free(alloc->ctx, block);
+        block = prev;
+    }
+}
+
+void pj_done(pj_parser_ref parser)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+
+    if (parser->pool != NULL && parser->buf != NULL) pj_give_back(parser);
+    if (parser->alloc == NULL || parser->buf == NULL) return;
+    pj_free_prev(parser);
+    parser->alloc->free(parser->alloc->ctx, parser->buf - PJ_BUF_HEAD);
+    parser->buf = parser->buf_end = parser->buf_ptr = NULL;
+    parser->buf_last = NULL;
+}
+
+void pj_set_options(pj_parser_ref parser, int options)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+
+    parser->options = options;
+}
+
+int pj_skip_value(pj_parser_ref parser)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+
+    const state s = pj_state(parser);
+    switch (s)
+    {
+    case S_INIT:
+    case S_COMMA:
+    case S_ARR:
+        break;
+    default:
+        return -1;
+    }
+    parser->skip.from = s;
+    parser->state = pj_new_state(parser, S_SKIP);
+    return 0;
+}
+
+int pj_set_projection(pj_parser_ref parser, pj_projection *proj,
+                      const char * const *paths, size_t n)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( paths != NULL || n == 0 );
+
+    parser->proj = NULL;
+    if (proj == NULL) return 0;
+    if (!pj_proj_init(proj, paths, n)) return -1;
+    parser->proj = proj;
+    return 0;
+}
+
+int pj_set_keys(pj_parser_ref parser, pj_keys *keys,
+                const char * const *names, size_t n)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( names != NULL || n == 0 );
+
+    parser->keys = NULL;
+    if (keys == NULL) return 0;
+    if (!pj_keys_init(keys, names, n)) return -1;
+    parser->keys = keys;
+    return 0;
 }
 
 void pj_feed_end(pj_parser_ref parser)
@@ -58,6 +208,7 @@ void pj_realloc(pj_parser_ref parser, char *buf, size_t buf_len)
 {
     TRACE_FUNC();
     assert( parser != NULL );
+    assert( parser->alloc == NULL && parser->pool == NULL ); /* buffer is owned by parser */
     assert( !pj_use_buf(parser) || (parser->buf <= parser->buf_last && parser->buf_last <= parser->buf_ptr) );
     assert( !pj_use_buf(parser) || (parser->buf_last + buf_len >= parser->buf_ptr) );
 
@@ -65,8 +216,9 @@ void pj_realloc(pj_parser_ref parser, char *buf, size_t buf_len)
     {
         /* relocate last partial token to buffer start */
         size_t prev_chunk_len = parser->buf_ptr - parser->buf_last;
-        (void) memmove(buf, parser->buf_last, prev_chunk_len);
+        if (buf != parser->buf_last) (void) memmove(buf, parser->buf_last, prev_chunk_len);
         parser->buf_ptr = buf + prev_chunk_len;
+        if (pj_key_pending(parser)) parser->key_str = buf;
     }
     else
     {
@@ -77,6 +229,94 @@ void pj_realloc(pj_parser_ref parser, char *buf, size_t buf_len)
     parser->buf_last = buf;
 }
 
+/* flush of what's left after pj_feed_end() and final PJ_END */
+static bool pj_end_tok(pj_parser_ref parser, pj_token *token)
+{
+    if (pj_state(parser) != S_END)
+    {
+        pj_flush_tok(parser, token);
+        if (parser->state == S_END || parser->state == S_ERR)
+            return false;
+
+        /* we should re-enter this code to give back PJ_END */
+        parser->state = pj_new_state(parser, S_END);
+        return true;
+    }
+    token->token_type = PJ_END;
+    parser->state = S_END; /* this is final PJ_END */
+    return false;
+}
+
+/* next token that goes to queue (false for terminal one) */
+static bool pj_queue_tok(pj_parser_ref parser, pj_token *token)
+{
+    for (;;)
+    {
+        const bool ok = pj_is_end(parser) ? pj_end_tok(parser, token) : pj_poll_tok(parser, token);
+
+        TRACE_TOKEN(token);
+        TRACE_PARSER(parser, parser->ptr);
+        if (!ok) break;
+
+        if (parser->keys != NULL) pj_key_tok(parser, token);
+        if (parser->proj != NULL && !pj_proj_filter(parser, token)) continue; /* dropped */
+        if ((parser->options & PJ_OPT_FUSED_KEY) && pj_key_fuse(parser, token)) continue;
+        return true;
+    }
+    if (token->token_type == PJ_STARVING && pj_key_pending(parser)) pj_key_hold(parser, token);
+    return false;
+}
+
+/* free tokens of previous poll from supplementary buffer */
+static void pj_poll_start(pj_parser_ref parser)
+{
+    if (parser->alloc != NULL) pj_free_prev(parser);
+    if (pj_use_buf(parser)) /* have incomplete token? */
+    {
+        /* relocate last partial token to buffer start (only once per token,
+         * while it grows over following chunks it stays there)
+         */
+        size_t prev_chunk_len = parser->buf_ptr - parser->buf_last;
+        if (parser->buf_last != parser->buf) (void) memmove(parser->buf, parser->buf_last, prev_chunk_len);
+        parser->buf_ptr = parser->buf + prev_chunk_len;
+        parser->buf_last = parser->buf;
+        if (pj_key_pending(parser)) parser->key_str = parser->buf;
+    }
+    else if (parser->pool != NULL && parser->buf != NULL)
+    {
+        pj_give_back(parser); /* tokens formed there are consumed */
+    }
+    else
+    {
+        parser->buf_ptr = parser->buf;
+        parser->buf_last = parser->buf;
+    }
+}
+
+/* fill tokens till terminal one or till len
+ * returns number of normal tokens (terminal one follows them if any)
+ */
+static size_t pj_fill(pj_parser_ref parser, pj_token *tokens, size_t len)
+{
+    size_t n = 0;
+
+    if (parser->held.token_type != PJ_END)
+    {
+        /* token that didn't fit into pj_ctoken goes first; buffer isn't
+         * recycled to keep it intact
+         */
+        tokens[n++] = parser->held;
+        parser->held.token_type = PJ_END;
+    }
+    else
+    {
+        pj_poll_start(parser);
+    }
+
+    while (n < len && pj_queue_tok(parser, &tokens[n])) ++n;
+    return n;
+}
+
 void pj_poll(pj_parser_ref parser, pj_token *tokens, size_t len)
 {
     TRACE_FUNC();
@@ -87,60 +327,203 @@ void pj_poll(pj_parser_ref parser, pj_token *tokens, size_t len)
 
     if (len == 0) return; /* nothing to fill */
 
-    pj_token *tokens_end = tokens + len;
+    (void) pj_fill(parser, tokens, len);
+}
 
-    if (pj_is_end(parser))
+size_t pj_poll_n(pj_parser_ref parser, pj_token *tokens, size_t len, pj_token *terminal)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( len > 0 );
+    assert( tokens != NULL );
+    assert( terminal != NULL );
+    assert( parser->state != S_ERR ); /* already reported an error */
+
+    if (len == 0) return 0; /* nothing to fill */
+
+    const size_t n = pj_fill(parser, tokens, len);
+    if (n < len) *terminal = tokens[n];
+    return n;
+}
+
+size_t pj_parse_buffer(pj_parser_ref parser, const char *doc, size_t doc_len, pj_token *tokens, size_t len)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( len > 0 );
+    assert( tokens != NULL );
+    assert( parser->state != S_ERR ); /* already reported an error */
+
+    if (doc != NULL)
     {
-        if (pj_state(parser) != S_END)
-        {
-            pj_flush_tok(parser, tokens);
+        assert( parser->chunk == NULL ); /* nothing fed before */
+        pj_feed(parser, doc, doc_len);
+    }
 
-            TRACE_TOKEN(tokens);
-            TRACE_PARSER(parser, parser->ptr);
+    if (len == 0) return 0; /* nothing to fill */
 
-            if (parser->state == S_END || parser->state == S_ERR)
-                return;
+    size_t n = 0;
+    if (parser->held.token_type != PJ_END)
+    {
+        tokens[n++] = parser->held; /* see pj_fill() */
+        parser->held.token_type = PJ_END;
+    }
+    else
+    {
+        pj_poll_start(parser);
+    }
 
-            /* next token to fill if possible */
-            if (++tokens == tokens_end)
-            {
-                /* we should re-enter this code to give back PJ_END */
-                parser->state = pj_new_state(parser, S_END);
-                return;
-            }
-        }
-        tokens->token_type = PJ_END;
-        parser->state = S_END; /* this is final PJ_END */
-        return;
+    if (parser->proj != NULL)
+    {
+        /* projection filters tokens on the way, leave it to general queue */
+        while (n < len && pj_doc_slow_tok(parser, &tokens[n])) ++n;
+        return n;
     }
+    return n + pj_doc_fill(parser, tokens + n, len - n);
+}
 
-    /* prepare suppl. buffer */
-    if (pj_use_buf(parser)) /* have incomplete token? */
+/* pack token into compact form, false if it doesn't fit */
+static bool pj_compact_tok(pj_parser_ref parser, const pj_token *token, pj_ctoken *ctoken)
+{
+    const unsigned type = token->token_type;
+    unsigned with_str = (1 << PJ_TOK_STR) | (1 << PJ_TOK_NUM) | (1 << PJ_TOK_STR_PART);
+
+    if (parser->options & PJ_OPT_FUSED_KEY) with_str |= 1 << PJ_TOK_KEY;
+    if (with_str & (1 << type))
     {
-        /* relocate last partial token to buffer start */
-        size_t prev_chunk_len = parser->buf_ptr - parser->buf_last;
-        (void) memmove(parser->buf, parser->buf_last, prev_chunk_len);
-        parser->buf_ptr = parser->buf + prev_chunk_len;
-        parser->buf_last = parser->buf;
+        const uintptr_t str = (uintptr_t)token->str;
+        uintptr_t offset = str - (uintptr_t)parser->chunk_start;
+        unsigned buf = 0;
+
+        if (offset > (uintptr_t)(parser->chunk_end - parser->chunk_start))
+        {
+            offset = str - (uintptr_t)parser->buf;
+            buf = PJ_CTOK_BUF;
+            /* neither (e.g. slice of previous chunks with PJ_OPT_CONTIGUOUS) */
+            if (offset > (uintptr_t)(parser->buf_end - parser->buf)) return false;
+        }
+        if (offset > UINT32_MAX || token->len > PJ_CTOK_LEN_MAX) return false;
+        if (token->flags & PJ_STR_ESC) return false; /* flag doesn't fit */
+        ctoken->offset = offset;
+        ctoken->info = (uint32_t)token->len << 8 | buf | type;
+    }
+    else if (type == PJ_OVERFLOW)
+    {
+        /* required size of buffer */
+        ctoken->offset = token->len > UINT32_MAX ? UINT32_MAX : token->len;
+        ctoken->info = type;
     }
     else
     {
-        /* free prev tokens from suppl. buffer */
-        parser->buf_ptr = parser->buf;
-        parser->buf_last = parser->buf;
+        ctoken->offset = 0;
+        ctoken->info = type;
     }
+    return true;
+}
+
+size_t pj_poll_compact(pj_parser_ref parser, pj_ctoken *tokens, size_t len)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( len > 0 );
+    assert( tokens != NULL );
+    assert( parser->state != S_ERR ); /* already reported an error */
 
-    for (; tokens != tokens_end && pj_poll_tok(parser, tokens); ++tokens)
+    if (len == 0) return 0; /* nothing to fill */
+
+    if (parser->held.token_type != PJ_END)
     {
-        TRACE_TOKEN(tokens);
-        TRACE_PARSER(parser, parser->ptr);
+        tokens->offset = 0;
+        tokens->info = PJ_CTOK_LONG;
+        return 0;
     }
-#ifdef ENABLE_TRACES
-    if (tokens != tokens_end)
+
+    pj_poll_start(parser);
+
+    size_t n;
+    for (n = 0; n < len; ++n)
     {
-        /* dump terminate token */
-        TRACE_TOKEN(tokens);
-        TRACE_PARSER(parser, parser->ptr);
+        pj_token token;
+        const bool ok = pj_queue_tok(parser, &token);
+        if (!pj_compact_tok(parser, &token, &tokens[n]))
+        {
+            parser->held = token; /* to be taken with pj_poll() */
+            tokens[n].offset = 0;
+            tokens[n].info = PJ_CTOK_LONG;
+            break;
+        }
+        if (!ok) break;
+    }
+    return n;
+}
+
+size_t pj_poll_soa(pj_parser_ref parser, uint8_t *types, uint32_t *offsets, uint32_t *lens, size_t len)
+{
+    TRACE_FUNC();
+    assert( parser != NULL );
+    assert( len > 0 );
+    assert( types != NULL && offsets != NULL && lens != NULL );
+    assert( parser->state != S_ERR ); /* already reported an error */
+
+    if (len == 0) return 0; /* nothing to fill */
+
+    if (parser->held.token_type != PJ_END)
+    {
+        types[0] = PJ_CTOK_LONG;
+        offsets[0] = lens[0] = 0;
+        return 0;
     }
-#endif
+
+    pj_poll_start(parser);
+
+    size_t i;
+    for (i = 0; i < len; ++i)
+    {
+        pj_token token;
+        pj_ctoken ctoken;
+        const bool ok = pj_queue_tok(parser, &token);
+        if (!pj_compact_tok(parser, &token, &ctoken))
+        {
+            parser->held = token; /* to be taken with pj_poll() */
+            types[i] = PJ_CTOK_LONG;
+            offsets[i] = lens[i] = 0;
+            break;
+        }
+        types[i] = ctoken.info & PJ_CTOK_TYPE_MASK;
+        offsets[i] = ctoken.offset;
+        lens[i] = (ctoken.info >> 8) | ((ctoken.info & PJ_CTOK_BUF) ? PJ_SOA_BUF : 0);
+        if (!ok) break;
+    }
+    return i;
+}
+
+double pj_token_to_double(const pj_token *token)
+{
+    TRACE_FUNC();
+    assert( token != NULL );
+    assert( token->token_type == PJ_TOK_NUM );
+
+    if (token->flags & PJ_NUM_DOUBLE) return token->val.d;
+    if ((token->flags & (PJ_NUM_INT | PJ_NUM_OVERFLOW)) == PJ_NUM_INT)
+    {
+        /* "-0" is negative zero, which integer doesn't keep */
+        if (token->val.i == 0 && token->len > 0 && token->str[0] == '-') return -0.0;
+        return (double)token->val.i;
+    }
+
+    struct pj_num_state num;
+    pj_num_scan(&num, token->str, token->len);
+    return pj_num_to_double(&num, token->str, token->len);
+}
+
+size_t pj_unescape(const char *str, size_t len, char *out, size_t out_len)
+{
+    TRACE_FUNC();
+    assert( str != NULL || len == 0 );
+    assert( out != NULL || out_len == 0 );
+
+    size_t decoded;
+    if (pj_unescape_slice(str, str + len, out, out + out_len, &decoded) != str + len)
+        return (size_t)-1; /* invalid or incomplete escape */
+    return decoded;
 }
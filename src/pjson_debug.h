@@ -59,6 +59,7 @@ static inline const char *token_type_name(pj_token_type token_type)
     case PJ_TOK_MAP: return "PJ_TOK_MAP";
     case PJ_TOK_KEY: return "PJ_TOK_KEY";
     case PJ_TOK_MAP_E: return "PJ_TOK_MAP_E";
+    case PJ_TOK_STR_PART: return "PJ_TOK_STR_PART";
     default: return "<todo>";
     }
 }
@@ -0,0 +1,277 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_doc_h__
+#define __pjson_doc_h__
+
+#include <string.h>
+
+#include "pjson.h"
+#include "pjson_state.h"
+#include "pjson_general.h"
+#include "pjson_keys.h"
+#include "pjson_simd.h"
+#include "pjson_debug.h"
+
+static bool pj_queue_tok(pj_parser_ref parser, pj_token *token);
+
+/* Whole document engine (see pj_parse_buffer()). Since document never
+ * continues past the end of chunk, tokens that are complete within it are
+ * lexed here in one loop with position and state kept in locals and nothing
+ * saved into parser between them. Everything else (comments, escapes,
+ * decoded numbers, errors, the end of document) goes through the usual
+ * resumable pj_queue_tok() which produces exactly the same tokens.
+ */
+
+static const char *pj_doc_space(pj_parser_ref parser, const char *p, const char * const p_end)
+{
+    if (p == p_end) return p;
+    switch (*p)
+    {
+    case '\t': case '\n': case '\r': case ' ':
+        return pj_scan_space(p+1, p_end, parser->chunk_pad);
+    default:
+        return p;
+    }
+}
+
+/* end of plain number at p, NULL if it's anything else (invalid one, one
+ * that reaches the end of chunk, etc.)
+ */
+static const char *pj_doc_number(pj_parser_ref parser, const char *p, const char * const p_end)
+{
+    const char * const p_pad = parser->chunk_pad;
+
+    if (*p == '-' && ++p == p_end) return NULL;
+    switch (*p)
+    {
+    case '0':
+        ++p;
+        break;
+    case '1' ... '9':
+        p = pj_scan_digits(p+1, p_end, p_pad);
+        break;
+    default:
+        return NULL;
+    }
+    if (p != p_end && *p == '.')
+    {
+        if (++p == p_end || *p < '0' || *p > '9') return NULL;
+        p = pj_scan_digits(p+1, p_end, p_pad);
+    }
+    if (p != p_end && (*p == 'e' || *p == 'E'))
+    {
+        if (++p != p_end && (*p == '-' || *p == '+')) ++p;
+        if (p == p_end || *p < '0' || *p > '9') return NULL;
+        p = pj_scan_digits(p+1, p_end, p_pad);
+    }
+    if (p == p_end) return NULL; /* flushed only by the end of input */
+    switch (*p)
+    {
+    case '0' ... '9':
+    case '-': case '+': case '.': case 'e': case 'E':
+        return NULL;
+    default:
+        return p;
+    }
+}
+
+static void pj_doc_tok(pj_parser_ref parser, pj_token *token, pj_token_type tok)
+{
+    token->token_type = tok;
+    token->flags = 0;
+    token->depth = parser->depth;
+}
+
+/* token with resumable lexer, the end of chunk is the end of document
+ * (false for terminal one)
+ */
+static bool pj_doc_slow_tok(pj_parser_ref parser, pj_token *token)
+{
+    if (pj_queue_tok(parser, token)) return true;
+    if (token->token_type != PJ_STARVING || pj_is_end(parser)) return false;
+    pj_set_end(parser);
+    return pj_queue_tok(parser, token);
+}
+
+/* same as pj_fill() for document that is the whole chunk */
+static size_t pj_doc_fill(pj_parser_ref parser, pj_token *tokens, size_t len)
+{
+    TRACE_FUNC();
+    assert( parser->proj == NULL );
+
+    const char *p = parser->ptr;
+    const char * const p_end = parser->chunk_end;
+    const bool fused = parser->options & PJ_OPT_FUSED_KEY;
+    const bool decode = parser->options & (PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE);
+    int s = parser->state; /* flags aren't expected between tokens */
+    size_t n = 0;
+
+    while (n < len)
+    {
+        pj_token * const token = &tokens[n];
+        const char *q;
+
+        switch (s)
+        {
+        case S_INIT:
+        case S_COMMA:
+        case S_ARR:
+            p = pj_doc_space(parser, p, p_end);
+            if (p == p_end) goto sync;
+            switch (*p)
+            {
+            case '[':
+            case '{':
+                if (parser->depth == PJ_MAX_DEPTH) goto sync;
+                pj_doc_tok(parser, token, *p == '{' ? PJ_TOK_MAP : PJ_TOK_ARR);
+                s = *p == '{' ? S_MAP : S_ARR;
+                pj_push(parser, *p == '{');
+                ++p;
+                break;
+            case ']':
+                if (s != S_ARR) goto sync;
+                --parser->depth;
+                pj_doc_tok(parser, token, PJ_TOK_ARR_E);
+                s = S_VALUE;
+                ++p;
+                break;
+            case '"':
+                q = pj_string_next(parser, p+1);
+                if (q == p_end || *q != '"') goto sync;
+                pj_doc_tok(parser, token, PJ_TOK_STR);
+                token->str = p+1;
+                token->len = q - (p+1);
+                s = S_VALUE;
+                p = q+1;
+                break;
+            case 'n':
+                if (p_end - p < 4 || memcmp(p, "null", 4) != 0) goto sync;
+                pj_doc_tok(parser, token, PJ_TOK_NULL);
+                s = S_VALUE;
+                p += 4;
+                break;
+            case 't':
+                if (p_end - p < 4 || memcmp(p, "true", 4) != 0) goto sync;
+                pj_doc_tok(parser, token, PJ_TOK_TRUE);
+                s = S_VALUE;
+                p += 4;
+                break;
+            case 'f':
+                if (p_end - p < 5 || memcmp(p, "false", 5) != 0) goto sync;
+                pj_doc_tok(parser, token, PJ_TOK_FALSE);
+                s = S_VALUE;
+                p += 5;
+                break;
+            case '-':
+            case '0' ... '9':
+                if (decode || (q = pj_doc_number(parser, p, p_end)) == NULL) goto sync;
+                pj_doc_tok(parser, token, PJ_TOK_NUM);
+                token->str = p;
+                token->len = q - p;
+                s = S_VALUE;
+                p = q;
+                break;
+            default:
+                goto sync;
+            }
+            break;
+
+        case S_MAP:
+        case S_KEY:
+            p = pj_doc_space(parser, p, p_end);
+            if (p == p_end) goto sync;
+            if (*p == '}' && s == S_MAP)
+            {
+                --parser->depth;
+                pj_doc_tok(parser, token, PJ_TOK_MAP_E);
+                s = S_VALUE;
+                ++p;
+                break;
+            }
+            if (*p != '"') goto sync;
+            q = pj_string_next(parser, p+1);
+            if (q == p_end || *q != '"') goto sync;
+            pj_doc_tok(parser, token, PJ_TOK_STR);
+            token->str = p+1;
+            token->len = q - (p+1);
+            s = S_COLON;
+            p = q+1;
+            parser->state = s; /* pj_key_tok() and pj_key_fuse() tell keys by it */
+            if (parser->keys != NULL) pj_key_tok(parser, token);
+            if (fused && pj_key_fuse(parser, token)) continue;
+            break;
+
+        case S_COLON:
+            p = pj_doc_space(parser, p, p_end);
+            if (p == p_end || *p != ':') goto sync;
+            pj_doc_tok(parser, token, PJ_TOK_KEY);
+            s = S_COMMA;
+            ++p;
+            if (parser->keys != NULL) pj_key_tok(parser, token);
+            if (fused) (void) pj_key_fuse(parser, token);
+            break;
+
+        case S_VALUE:
+            p = pj_doc_space(parser, p, p_end);
+            if (p == p_end) goto sync;
+            switch (*p)
+            {
+            case ',':
+                s = pj_in_map(parser) ? S_KEY : S_COMMA;
+                ++p;
+                continue;
+            case ']':
+            case '}':
+                if (parser->depth == 0 || pj_in_map(parser) != (*p == '}')) goto sync;
+                --parser->depth;
+                pj_doc_tok(parser, token, *p == '}' ? PJ_TOK_MAP_E : PJ_TOK_ARR_E);
+                ++p;
+                break;
+            default:
+                goto sync;
+            }
+            break;
+
+        default:
+            goto slow;
+        }
+        ++n;
+        continue;
+
+    sync:
+        /* hand over position to resumable lexer */
+        parser->ptr = p;
+        parser->chunk = p;
+        parser->state = s;
+    slow:
+        if (!pj_doc_slow_tok(parser, token)) return n;
+        ++n;
+        assert( parser->chunk == parser->ptr );
+        p = parser->ptr;
+        s = parser->state;
+    }
+
+    parser->ptr = p;
+    parser->chunk = p;
+    parser->state = s;
+    return n;
+}
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_double_h__
+#define __pjson_double_h__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#include "pjson.h"
+#include "pjson_pow5.h"
+#include "pjson_debug.h"
+
+/* Decimal to double conversion. Number lexer collects up to 19 significant
+ * digits into mant and decimal exponent of them (see struct pj_num_state).
+ * That goes through:
+ *   - exact multiplication/division by small power of 10 (Clinger);
+ *   - Eisel-Lemire algorithm over 128-bit powers of 5;
+ *   - strtod() of normalized digits (no decimal point to depend on locale)
+ *     for the rare cases the two above can't decide.
+ */
+
+/* significant digits that fit into uint64_t */
+#define PJ_MANT_DIGITS 19
+
+/* digits that are always enough to round correctly (rest is sticky) */
+#define PJ_FALLBACK_DIGITS 800
+
+/* account next digit of integer part */
+static void pj_num_int_digit(struct pj_num_state *num, char c)
+{
+    if (num->digits < PJ_MANT_DIGITS)
+    {
+        num->mant = num->mant * 10 + (c - '0');
+        ++num->digits;
+    }
+    else
+    {
+        ++num->exp10;
+        num->inexact |= (c != '0');
+    }
+}
+
+/* account next digit of fractional part */
+static void pj_num_frac_digit(struct pj_num_state *num, char c)
+{
+    if (num->digits < PJ_MANT_DIGITS)
+    {
+        if (num->mant != 0 || c != '0') /* skip leading zeroes */
+        {
+            num->mant = num->mant * 10 + (c - '0');
+            ++num->digits;
+        }
+        --num->exp10;
+    }
+    else
+    {
+        num->inexact |= (c != '0');
+    }
+}
+
+/* account next digit of exponent */
+static void pj_num_exp_digit(struct pj_num_state *num, char c)
+{
+    if (num->exp < 100000) num->exp = num->exp * 10 + (c - '0'); /* saturate */
+}
+
+/* high and low words of a * b */
+static uint64_t pj_mul128(uint64_t a, uint64_t b, uint64_t *lo)
+{
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    *lo = (uint64_t)r;
+    return (uint64_t)(r >> 64);
+#else
+    const uint64_t a0 = (uint32_t)a, a1 = a >> 32, b0 = (uint32_t)b, b1 = b >> 32;
+    const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    const uint64_t mid = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+    *lo = (mid << 32) | (uint32_t)p00;
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+/* w * 10^q rounded to nearest double
+ * returns false if result can't be decided that way
+ */
+static bool pj_eisel_lemire(uint64_t w, int64_t q, double *value)
+{
+    uint64_t lo, hi, bits;
+
+    assert( w != 0 );
+    if (q < PJ_POW5_MIN)
+    {
+        *value = 0.0; /* below half of smallest denormal even for 19 digits */
+        return true;
+    }
+    if (q > PJ_POW5_MAX)
+    {
+        *value = HUGE_VAL;
+        return true;
+    }
+
+    const uint64_t *pow5 = pj_pow5[q - PJ_POW5_MIN];
+    const int64_t exponent = (((152170 + 65536) * q) >> 16) + 1024 + 63;
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    hi = pj_mul128(w, pow5[0], &lo);
+    if ((hi & 0x1ff) == 0x1ff && lo + w < lo)
+    {
+        /* not enough precision: take low word of power into account */
+        uint64_t lo2;
+        const uint64_t mid2 = pj_mul128(w, pow5[1], &lo2);
+        const uint64_t mid = lo + mid2;
+        if (mid < lo) ++hi;
+        if (mid + 1 == 0 && (hi & 0x1ff) == 0x1ff && lo2 + w < lo2) return false;
+        lo = mid;
+    }
+
+    const uint64_t upperbit = hi >> 63;
+    uint64_t mant = hi >> (upperbit + 9);
+    lz += (int)(1 ^ upperbit);
+
+    /* exactly in the middle between two doubles */
+    if (lo == 0 && (hi & 0x1ff) == 0 && (mant & 3) == 1) return false;
+
+    mant += mant & 1;
+    mant >>= 1;
+    if (mant >= ((uint64_t)1 << 53))
+    {
+        mant = (uint64_t)1 << 52;
+        --lz;
+    }
+    mant &= ~((uint64_t)1 << 52);
+
+    const int64_t real_exponent = exponent - lz;
+    if (real_exponent < 1 || real_exponent > 2046) return false; /* denormal or infinity */
+
+    bits = mant | ((uint64_t)real_exponent << 52);
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+}
+
+/* strtod() over number text re-written as integer digits and exponent
+ * (i.e. without locale specific decimal point)
+ */
+static double pj_strtod(const char *str, size_t len)
+{
+    const char * const end = str + len;
+    char buf[PJ_FALLBACK_DIGITS + 32];
+    size_t n = 0, start;
+    long scale = 0, exp = 0;
+    bool sticky = false, frac = false;
+
+    if (str != end && *str == '-') buf[n++] = *str++;
+    start = n;
+    for (; str != end; ++str)
+    {
+        const char c = *str;
+        if (c == '.')
+        {
+            frac = true;
+            continue;
+        }
+        if (c < '0' || c > '9') break;
+
+        if (frac) --scale;
+        if (n == start && c == '0') continue; /* leading zero */
+        if (n - start < PJ_FALLBACK_DIGITS)
+        {
+            buf[n++] = c;
+        }
+        else
+        {
+            ++scale;
+            sticky |= (c != '0');
+        }
+    }
+    if (str != end) /* exponent */
+    {
+        bool neg = false;
+        ++str;
+        if (str != end && (*str == '-' || *str == '+')) neg = (*str++ == '-');
+        for (; str != end; ++str)
+        {
+            if (exp < 100000) exp = exp * 10 + (*str - '0');
+        }
+        if (neg) exp = -exp;
+    }
+    if (sticky)
+    {
+        /* anything between last kept digit and the next one */
+        buf[n++] = '1';
+        --scale;
+    }
+    if (n == start) buf[n++] = '0';
+    snprintf(buf + n, sizeof(buf) - n, "e%ld", exp + scale);
+    return strtod(buf, NULL);
+}
+
+/* value of number with collected digits
+ * str and len is the whole text of number for fallback
+ */
+static double pj_num_to_double(const struct pj_num_state *num, const char *str, size_t len)
+{
+    const int64_t q = (int64_t)num->exp10 + (num->exp_neg ? -num->exp : num->exp);
+    double value;
+
+    if (num->mant == 0) return num->neg ? -0.0 : 0.0;
+
+#if FLT_EVAL_METHOD == 0
+    if (!num->inexact && num->mant <= ((uint64_t)1 << 53) && -22 <= q && q <= 22)
+    {
+        /* both operands are exact, so is correctly rounded result */
+        static const double pow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        value = (double)num->mant;
+        value = q < 0 ? value / pow10[-q] : value * pow10[q];
+        return num->neg ? -value : value;
+    }
+#endif
+
+    if (pj_eisel_lemire(num->mant, q, &value))
+    {
+        double upper;
+        /* dropped digits may only move value towards mant + 1 */
+        if (!num->inexact ||
+            (pj_eisel_lemire(num->mant + 1, q, &upper) && upper == value))
+        {
+            return num->neg ? -value : value;
+        }
+    }
+
+    TRACEF("pj_num_to_double() fallback for \"%.*s\"", (int)len, str);
+    return pj_strtod(str, len);
+}
+
+/* collect digits from text of valid number */
+static void pj_num_scan(struct pj_num_state *num, const char *str, size_t len)
+{
+    const char * const end = str + len;
+
+    memset(num, 0, sizeof(*num));
+    if (str != end && *str == '-')
+    {
+        num->neg = 1;
+        ++str;
+    }
+    for (; str != end && *str >= '0' && *str <= '9'; ++str)
+    {
+        if (num->mant != 0 || *str != '0') pj_num_int_digit(num, *str);
+    }
+    if (str != end && *str == '.')
+    {
+        for (++str; str != end && *str >= '0' && *str <= '9'; ++str)
+            pj_num_frac_digit(num, *str);
+    }
+    if (str != end) /* exponent */
+    {
+        ++str;
+        if (str != end && (*str == '-' || *str == '+')) num->exp_neg = (*str++ == '-');
+        for (; str != end; ++str) pj_num_exp_digit(num, *str);
+    }
+}
+
+#endif
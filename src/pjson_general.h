@@ -17,12 +17,11 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-static bool pj_poll_tok(pj_parser_ref parser, pj_token *token);
-
 #ifndef __pjson_general_h__
 #define __pjson_general_h__
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "pjson.h"
 #include "pjson_state.h"
@@ -30,6 +29,8 @@ static bool pj_poll_tok(pj_parser_ref parser, pj_token *token);
 #include "pjson_keyword.h"
 #include "pjson_string.h"
 #include "pjson_number.h"
+#include "pjson_skip.h"
+#include "pjson_projection.h"
 #include "pjson_debug.h"
 
 /* parsing internals */
@@ -39,24 +40,32 @@ static void pj_flush_tok(pj_parser_ref parser, pj_token *token)
     assert( pj_state(parser) != S_ERR );
     assert( pj_state(parser) != S_END );
 
-    if (pj_is_end(parser))
+    if (pj_is_end(parser) && parser->depth == 0)
     {
         switch (pj_state(parser))
         {
         case S_INIT:
         case S_VALUE:
-        case S_STR_VALUE:
             /* nothing to flush */
             parser->state = S_END;
             token->token_type = PJ_END;
             return;
         case S_NUM ... S_NUM_END:
-            if (pj_use_buf(parser))
+            if (pj_use_buf(parser) || parser->chunk != parser->ptr)
             {
                 pj_number_flush(parser, token);
                 return;
             }
-            /* fall case through to the error */
+            break; /* incomplete number */
+        case S_SKIP:
+            if (parser->skip.depth == 0 && parser->skip.started)
+            {
+                /* skipped scalar till the end */
+                parser->state = S_END;
+                token->token_type = PJ_END;
+                return;
+            }
+            break;
         default: ;
         }
     }
@@ -69,196 +78,263 @@ static const char
     * const s_true = "true",
     * const s_false = "false";
 
-static bool pj_poll_tok(pj_parser_ref parser, pj_token *token)
+/* '[' or '{' */
+static bool pj_open_tok(pj_parser_ref parser, pj_token *token, const char *p, bool map)
 {
-    TRACE_FUNC();
-    assert( pj_state(parser) != S_ERR );
-    assert( pj_state(parser) != S_END );
-
-    const char *p = parser->ptr;
-    const char * const p_end = parser->chunk_end;
-    state s = pj_state(parser);
-
-    switch (s)
+    if (parser->depth == PJ_MAX_DEPTH)
     {
-    case S_END:
-        token->token_type = PJ_END;
+        pj_err_tok(parser, token);
         return false;
-    case S_ERR:
-        token->token_type = PJ_ERR;
+    }
+    if (map) pj_tok(parser, token, p, S_MAP, PJ_TOK_MAP);
+    else pj_tok(parser, token, p, S_ARR, PJ_TOK_ARR);
+    pj_push(parser, map);
+    return true;
+}
+
+/* ']' or '}' matching the innermost open one */
+static bool pj_close_tok(pj_parser_ref parser, pj_token *token, const char *p, bool map)
+{
+    if (parser->depth == 0 || pj_in_map(parser) != map)
+    {
+        pj_err_tok(parser, token);
         return false;
+    }
+    --parser->depth;
+    pj_tok(parser, token, p, S_VALUE, map ? PJ_TOK_MAP_E : PJ_TOK_ARR_E);
+    return true;
+}
 
-    case S_INIT:
-        if (p == p_end)
-        {
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-        switch (*p)
-        {
-        case '\t': case '\n': case '\r': case ' ':
-            return pj_space(parser, token, p+1, S_INIT);
-        case '/':
-            return pj_comment_start(parser, token, p+1, S_INIT);
-        case 'n':
-            parser->state = S_N;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_null, S_N, PJ_TOK_NULL);
-        case 't':
-            parser->state = S_T;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_true, S_T, PJ_TOK_TRUE);
-        case 'f':
-            parser->state = S_F;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_false, S_F, PJ_TOK_FALSE);
-        case '[':
-            pj_tok(parser, token, ++p, S_INIT, PJ_TOK_ARR);
-            return true;
-        case ']':
-            pj_tok(parser, token, ++p, S_VALUE, PJ_TOK_ARR_E);
-            return true;
-        case '{':
-            pj_tok(parser, token, ++p, S_INIT, PJ_TOK_MAP);
-            return true;
-        case '}':
-            pj_tok(parser, token, ++p, S_VALUE, PJ_TOK_MAP_E);
-            return true;
-        case '"':
-            parser->state = S_STR;
-            parser->chunk = ++p;
-            return pj_string(parser, token, p);
+/* opening quote of string that ends up in state s */
+static bool pj_string_start(pj_parser_ref parser, pj_token *token, const char *p, state s)
+{
+    parser->state = S_STR;
+    parser->state0 = s;
+    parser->chunk = p;
+    parser->str.tail_len = 0;
+    return pj_string(parser, token, p);
+}
 
-        case '-':
-        case '0' ... '9':
-            return pj_number(parser, token, S_NUM, p);
+/* first char of any value */
+static bool pj_value_start(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    switch (*p)
+    {
+    case 'n':
+        parser->state = S_N;
+        parser->ptr = ++p;
+        return pj_keyword(parser, token, s_null, S_N, PJ_TOK_NULL);
+    case 't':
+        parser->state = S_T;
+        parser->ptr = ++p;
+        return pj_keyword(parser, token, s_true, S_T, PJ_TOK_TRUE);
+    case 'f':
+        parser->state = S_F;
+        parser->ptr = ++p;
+        return pj_keyword(parser, token, s_false, S_F, PJ_TOK_FALSE);
+    case '[':
+        return pj_open_tok(parser, token, ++p, false);
+    case '{':
+        return pj_open_tok(parser, token, ++p, true);
+    case '"':
+        return pj_string_start(parser, token, ++p, S_VALUE);
 
-        default:
-            pj_err_tok(parser, token);
-            return false;
-        }
+    case '-':
+    case '0' ... '9':
+        /* shares union with state of other tokens (e.g. UTF-8 tail left by
+         * string cut in the middle of char)
+         */
+        memset(&parser->num, 0, sizeof(parser->num));
+        return pj_number(parser, token, S_NUM, p);
 
-    case S_COMMA:
-        if (p == p_end)
-        {
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-        switch (*p)
-        {
-        case '\t': case '\n': case '\r': case ' ':
-            return pj_space(parser, token, p+1, S_COMMA);
-        case '/':
-            return pj_comment_start(parser, token, p+1, S_COMMA);
-        case 'n':
-            parser->state = S_N;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_null, S_N, PJ_TOK_NULL);
-        case 't':
-            parser->state = S_T;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_true, S_T, PJ_TOK_TRUE);
-        case 'f':
-            parser->state = S_F;
-            parser->ptr = ++p;
-            return pj_keyword(parser, token, s_false, S_F, PJ_TOK_FALSE);
-        case '[':
-            pj_tok(parser, token, ++p, S_INIT, PJ_TOK_ARR);
-            return true;
-        case '{':
-            pj_tok(parser, token, ++p, S_INIT, PJ_TOK_MAP);
-            return true;
-        case '"':
-            parser->state = S_STR;
-            parser->chunk = ++p;
-            return pj_string(parser, token, p);
+    default:
+        pj_err_tok(parser, token);
+        return false;
+    }
+}
 
-        case '-':
-        case '0' ... '9':
-            return pj_number(parser, token, S_NUM, p);
+/* next token; white-space, comments, ',' and skipped values move parser
+ * on without one and lexing goes on in the loop (no recursion)
+ */
+static bool pj_poll_tok(pj_parser_ref parser, pj_token *token)
+{
+    TRACE_FUNC();
+    for (;;)
+    {
+        assert( pj_state(parser) != S_ERR );
+        assert( pj_state(parser) != S_END );
 
-        default:
-            pj_err_tok(parser, token);
+        const char *p = parser->ptr;
+        const char * const p_end = parser->chunk_end;
+        state s = pj_state(parser);
+
+        switch (s)
+        {
+        case S_END:
+            token->token_type = PJ_END;
+            return false;
+        case S_ERR:
+            token->token_type = PJ_ERR;
             return false;
-        }
 
-    case S_N ... S_NUL:
-        return pj_keyword(parser, token, s_null, S_N, PJ_TOK_NULL);
+        case S_INIT:
+        case S_COMMA:
+        case S_ARR:
+            if (parser->proj != NULL && pj_proj_skip_item(parser, s))
+            {
+                if (pj_skip(parser, token, p)) continue;
+                return false;
+            }
+            if (p == p_end)
+            {
+                token->token_type = PJ_STARVING;
+                return false;
+            }
+            switch (*p)
+            {
+            case '\t': case '\n': case '\r': case ' ':
+                if (pj_space(parser, token, p+1, s)) continue;
+                return false;
+            case '/':
+                if (pj_comment_start(parser, token, p+1, s)) continue;
+                return false;
+            case ']':
+                if (s == S_ARR) return pj_close_tok(parser, token, ++p, false);
+                pj_err_tok(parser, token);
+                return false;
+            default:
+                return pj_value_start(parser, token, p);
+            }
 
-    case S_T ... S_TRU:
-        return pj_keyword(parser, token, s_true, S_T, PJ_TOK_TRUE);
+        case S_MAP:
+        case S_KEY:
+            if (p == p_end)
+            {
+                token->token_type = PJ_STARVING;
+                return false;
+            }
+            switch (*p)
+            {
+            case '\t': case '\n': case '\r': case ' ':
+                if (pj_space(parser, token, p+1, s)) continue;
+                return false;
+            case '/':
+                if (pj_comment_start(parser, token, p+1, s)) continue;
+                return false;
+            case '"':
+                return pj_string_start(parser, token, ++p, S_COLON);
+            case '}':
+                if (s == S_MAP) return pj_close_tok(parser, token, ++p, true);
+                /* fall through */
+            default:
+                pj_err_tok(parser, token);
+                return false;
+            }
 
-    case S_F ... S_FALS:
-        return pj_keyword(parser, token, s_false, S_F, PJ_TOK_FALSE);
+        case S_COLON:
+            if (p == p_end)
+            {
+                token->token_type = PJ_STARVING;
+                return false;
+            }
+            switch (*p)
+            {
+            case '\t': case '\n': case '\r': case ' ':
+                if (pj_space(parser, token, p+1, s)) continue;
+                return false;
+            case '/':
+                if (pj_comment_start(parser, token, p+1, s)) continue;
+                return false;
+            case ':':
+                pj_tok(parser, token, ++p, S_COMMA, PJ_TOK_KEY);
+                return true;
+            default:
+                pj_err_tok(parser, token);
+                return false;
+            }
 
-    case S_NUM ... S_NUM_END:
-        return pj_number(parser, token, s, p);
+        case S_N ... S_NUL:
+            return pj_keyword(parser, token, s_null, S_N, PJ_TOK_NULL);
 
-    case S_STR:
-        return pj_string(parser, token, p);
-    case S_ESC:
-        return pj_string_esc(parser, token, p);
-    case S_UNICODE_ESC:
-        return pj_unicode_esc(parser, token, p);
-    case S_UNICODE ... S_UNICODE_FINISH:
-        return pj_unicode(parser, token, p);
+        case S_T ... S_TRU:
+            return pj_keyword(parser, token, s_true, S_T, PJ_TOK_TRUE);
 
-    case S_VALUE:
-    case S_STR_VALUE:
-        if (p == p_end)
-        {
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-        switch (*p)
-        {
-        case '\t': case '\n': case '\r': case ' ':
-            return pj_space(parser, token, p+1, s);
-        case '/':
-            return pj_comment_start(parser, token, p+1, s);
+        case S_F ... S_FALS:
+            return pj_keyword(parser, token, s_false, S_F, PJ_TOK_FALSE);
 
-        case ',':
-            parser->ptr = ++p;
-            parser->chunk = p;
-            parser->state = S_COMMA;
-            return pj_poll_tok(parser, token);
+        case S_NUM ... S_NUM_END:
+            return pj_number(parser, token, s, p);
 
-        case ']':
-            pj_tok(parser, token, ++p, S_VALUE, PJ_TOK_ARR_E);
-            return true;
-        case '}':
-            pj_tok(parser, token, ++p, S_VALUE, PJ_TOK_MAP_E);
-            return true;
+        case S_STR:
+            if (parser->state & F_ESC) return pj_string_slice(parser, token, p);
+            return pj_string(parser, token, p);
+        case S_ESC:
+            return pj_string_esc(parser, token, p);
+        case S_UNICODE_ESC:
+            return pj_unicode_esc(parser, token, p);
+        case S_UNICODE ... S_UNICODE_FINISH:
+            return pj_unicode(parser, token, p);
 
-        case ':':
-            /* colon allowed only after str */
-            if (s == S_STR_VALUE)
+        case S_VALUE:
+            if (p == p_end)
             {
-                pj_tok(parser, token, ++p, S_INIT, PJ_TOK_KEY);
-                return true;
+                token->token_type = PJ_STARVING;
+                return false;
             }
-            /* fall through to error */
+            switch (*p)
+            {
+            case '\t': case '\n': case '\r': case ' ':
+                if (pj_space(parser, token, p+1, s)) continue;
+                return false;
+            case '/':
+                if (pj_comment_start(parser, token, p+1, s)) continue;
+                return false;
 
-        default:
-            pj_err_tok(parser, token);
+            case ',':
+                parser->ptr = ++p;
+                parser->chunk = p;
+                parser->state = pj_in_map(parser) ? S_KEY : S_COMMA;
+                continue;
+
+            case ']':
+                return pj_close_tok(parser, token, ++p, false);
+            case '}':
+                return pj_close_tok(parser, token, ++p, true);
+
+            default:
+                pj_err_tok(parser, token);
+                return false;
+            }
+
+        case S_SKIP:
+            if (pj_skip(parser, token, p)) continue;
+            return false;
+        case S_SKIP_STR:
+            if (pj_skip_str(parser, token, p)) continue;
+            return false;
+        case S_SKIP_ESC:
+            if (pj_skip_esc(parser, token, p)) continue;
             return false;
-        }
 
-    case S_COMMENT_START:
-        return pj_comment_start(parser, token, p, parser->state0);
-    case S_COMMENT_LINE:
-        return pj_comment_line(parser, token, p, parser->state0);
-    case S_COMMENT_REGION:
-        return pj_comment_region(parser, token, p, parser->state0);
-    case S_COMMENT_END:
-        return pj_comment_end(parser, token, p, parser->state0);
+        case S_COMMENT_START:
+            if (pj_comment_start(parser, token, p, parser->state0)) continue;
+            return false;
+        case S_COMMENT_LINE:
+            if (pj_comment_line(parser, token, p, parser->state0)) continue;
+            return false;
+        case S_COMMENT_REGION:
+            if (pj_comment_region(parser, token, p, parser->state0, false)) continue;
+            return false;
+        case S_COMMENT_END:
+            if (pj_comment_region(parser, token, p, parser->state0, true)) continue;
+            return false;
 
-    default:
-        assert(!"invalid state"); /* improperly initialized parser? */
-        abort();
+        default:
+            assert(!"invalid state"); /* improperly initialized parser? */
+            abort();
+        }
     }
-
-    // unreachable code
+    /* unreachable */
 }
 
 #endif
@@ -0,0 +1,253 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_keys_h__
+#define __pjson_keys_h__
+
+#include "pjson.h"
+#include "pjson_state.h"
+#include "pjson_debug.h"
+
+/* Dictionary of registered keys is a perfect hash built with "hash and
+ * displace": 64-bit hash of key picks bucket and each bucket has
+ * displacement that moves all of its keys into free slots of table. So
+ * lookup is one hash, one slot and comparison of two words (memcmp() only
+ * for keys longer than 16 bytes).
+ */
+
+#define PJ_KEYS_BUCKETS PJ_KEYS_MAX
+
+/* tries of displacement per bucket before giving up */
+#define PJ_KEYS_TRIES 0x10000
+
+static uint64_t pj_key_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* first and last (overlapping) words of key; together they cover whole
+ * key of up to 16 bytes, so comparing them is enough for short keys
+ */
+static void pj_key_words(const char *str, size_t len, uint64_t *head, uint64_t *tail)
+{
+    if (len >= 8)
+    {
+        memcpy(head, str, 8);
+        memcpy(tail, str + len - 8, 8);
+    }
+    else if (len >= 4)
+    {
+        uint32_t h, t;
+        memcpy(&h, str, 4);
+        memcpy(&t, str + len - 4, 4);
+        *head = h;
+        *tail = t;
+    }
+    else if (len > 0)
+    {
+        *head = (uint8_t)str[0] | (uint8_t)str[len / 2] << 8 | (uint8_t)str[len - 1] << 16;
+        *tail = 0;
+    }
+    else
+    {
+        *head = *tail = 0;
+    }
+}
+
+static uint64_t pj_key_hash(const char *str, size_t len, uint64_t head, uint64_t tail)
+{
+    uint64_t h = (head ^ len) * 0x9e3779b97f4a7c15ULL;
+    h ^= (tail + (h >> 32)) * 0xc4ceb9fe1a85ec53ULL;
+    if (len > 16)
+    {
+        /* middle of long key */
+        const char *p, * const end = str + len - 8;
+        for (p = str + 8; p < end; p += 8)
+        {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 29;
+        }
+    }
+    return pj_key_mix(h);
+}
+
+static unsigned pj_key_bucket(uint64_t h)
+{ return (h >> 32) % PJ_KEYS_BUCKETS; }
+
+static unsigned pj_key_slot(uint64_t h, uint16_t disp)
+{ return pj_key_mix(h ^ disp) % PJ_KEYS_SLOTS; }
+
+/* id of key str or -1 if not registered */
+static int pj_key_lookup(const pj_keys *keys, const char *str, size_t len)
+{
+    uint64_t head, tail;
+    pj_key_words(str, len, &head, &tail);
+    const uint64_t h = pj_key_hash(str, len, head, tail);
+    const int id = (int)keys->slots[pj_key_slot(h, keys->disp[pj_key_bucket(h)])] - 1;
+    if (id < 0 || keys->lens[id] != len || keys->heads[id] != head || keys->tails[id] != tail)
+        return -1;
+    if (len > 16 && memcmp(keys->keys[id], str, len) != 0) return -1;
+    return id;
+}
+
+/* build perfect hash for n keys */
+static bool pj_keys_init(pj_keys *keys, const char * const *names, size_t n)
+{
+    uint64_t hashes[PJ_KEYS_MAX];
+    uint8_t order[PJ_KEYS_BUCKETS], sizes[PJ_KEYS_BUCKETS] = { 0 };
+    size_t i, j;
+
+    memset(keys, 0, sizeof(*keys));
+    if (n > PJ_KEYS_MAX) return false;
+    keys->keys = names;
+    for (i = 0; i < n; ++i)
+    {
+        const size_t len = strlen(names[i]);
+        if (len > UINT16_MAX) return false;
+        keys->lens[i] = len;
+        pj_key_words(names[i], len, &keys->heads[i], &keys->tails[i]);
+        hashes[i] = pj_key_hash(names[i], len, keys->heads[i], keys->tails[i]);
+        ++sizes[pj_key_bucket(hashes[i])];
+        for (j = 0; j < i; ++j)
+        {
+            if (hashes[j] == hashes[i]) return false; /* duplicate (or really unlucky) */
+        }
+    }
+
+    /* place biggest buckets first (insertion sort of bucket numbers) */
+    for (i = 0; i < PJ_KEYS_BUCKETS; ++i)
+    {
+        for (j = i; j > 0 && sizes[order[j - 1]] < sizes[i]; --j) order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    for (i = 0; i < PJ_KEYS_BUCKETS && sizes[order[i]] > 0; ++i)
+    {
+        const unsigned b = order[i];
+        uint32_t disp;
+        for (disp = 0; disp < PJ_KEYS_TRIES; ++disp)
+        {
+            size_t placed = 0;
+            for (j = 0; j < n; ++j)
+            {
+                if (pj_key_bucket(hashes[j]) != b) continue;
+                const unsigned slot = pj_key_slot(hashes[j], disp);
+                if (keys->slots[slot] != 0) break; /* taken (maybe by this bucket) */
+                keys->slots[slot] = j + 1;
+                ++placed;
+            }
+            if (placed == sizes[b]) break;
+
+            /* roll back */
+            for (j = 0; j < PJ_KEYS_SLOTS; ++j)
+            {
+                const unsigned id = keys->slots[j];
+                if (id != 0 && pj_key_bucket(hashes[id - 1]) == b) keys->slots[j] = 0;
+            }
+        }
+        if (disp == PJ_KEYS_TRIES) return false;
+        keys->disp[b] = disp;
+    }
+    return true;
+}
+
+/* mark key strings with their ids and pass them to PJ_TOK_KEY */
+static void pj_key_tok(pj_parser_ref parser, pj_token *token)
+{
+    switch (token->token_type)
+    {
+    case PJ_TOK_STR:
+        if (pj_state(parser) != S_COLON) break; /* not a key */
+        parser->key = pj_key_lookup(parser->keys, token->str, token->len);
+        token->flags |= PJ_STR_KEY;
+        token->val.key = parser->key;
+        TRACEF("key \"%.*s\" id %d", (int)token->len, token->str, parser->key);
+        break;
+    case PJ_TOK_KEY:
+        token->val.key = parser->key;
+        break;
+    default: ;
+    }
+}
+
+/* fused keys (PJ_OPT_FUSED_KEY): key string is held by parser till ':' and
+ * handed out with PJ_TOK_KEY; if chunk ends before ':' key is moved into
+ * supplementary buffer as incomplete token to survive till next chunk
+ */
+
+/* between key string and ':' of fused key */
+static bool pj_key_pending(pj_parser_ref parser)
+{
+    if (!(parser->options & PJ_OPT_FUSED_KEY)) return false;
+    switch (pj_state(parser))
+    {
+    case S_COLON:
+        return true;
+    case S_COMMENT_START ... S_COMMENT_END:
+        return parser->state0 == S_COLON;
+    default:
+        return false;
+    }
+}
+
+/* returns true if token is consumed (key string held till PJ_TOK_KEY) */
+static bool pj_key_fuse(pj_parser_ref parser, pj_token *token)
+{
+    switch (token->token_type)
+    {
+    case PJ_TOK_STR:
+        if (pj_state(parser) != S_COLON) return false;
+        parser->key_str = token->str;
+        parser->key_len = token->len;
+        return true;
+    case PJ_TOK_KEY:
+        token->str = parser->key_str;
+        token->len = parser->key_len;
+        parser->buf_last = parser->buf_ptr; /* no longer incomplete */
+        return false;
+    default:
+        return false;
+    }
+}
+
+/* keep pending key for the next chunk (token is PJ_STARVING) */
+static void pj_key_hold(pj_parser_ref parser, pj_token *token)
+{
+    const char *key = parser->key_str;
+    const size_t len = parser->key_len;
+
+    if (key + len != parser->buf_ptr) /* still in chunk */
+    {
+        if (parser->options & PJ_OPT_CONTIGUOUS) return; /* stays valid */
+        if (!pj_reserve(parser, token, len, parser->ptr)) return;
+        key = parser->buf_ptr;
+        if (len > 0) (void) memcpy(parser->buf_ptr, parser->key_str, len);
+        parser->buf_ptr += len;
+        parser->key_str = key;
+    }
+    parser->buf_last = key;
+    parser->state |= F_BUF;
+}
+
+#endif
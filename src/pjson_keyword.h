@@ -20,6 +20,8 @@
 #ifndef __pjson_keyword_h__
 #define __pjson_keyword_h__
 
+#include <string.h>
+
 #include "pjson.h"
 #include "pjson_state.h"
 
@@ -30,11 +32,23 @@ static bool pj_keyword(pj_parser_ref parser, pj_token *token,
     const char *p = parser->ptr;
     const char * const p_end = parser->chunk_end;
     const char * s = keyword + (parser->state - base_s) + 1;
+    const size_t rest = strlen(s);
+
+    if ((size_t)(p_end - p) >= rest && memcmp(p, s, rest) == 0)
+    {
+        /* rest of keyword is in chunk: compare it at once */
+        pj_tok(parser, token, p + rest, S_VALUE, tok);
+        return true;
+    }
 
     for (;;)
     {
         if (p == p_end)
         {
+            /* remember how far we matched */
+            parser->state = base_s + (s - keyword - 1);
+            parser->ptr = p;
+            parser->chunk = p;
             token->token_type = PJ_STARVING;
             return false;
         }
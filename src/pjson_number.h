@@ -22,8 +22,38 @@
 
 #include "pjson.h"
 #include "pjson_state.h"
+#include "pjson_double.h"
+#include "pjson_simd.h"
 #include "pjson_debug.h"
 
+/* fill in value of number collected in parser->num */
+static void pj_number_value(pj_parser_ref parser, pj_token *token, state s)
+{
+    const struct pj_num_state *num = &parser->num;
+
+    if ((parser->options & PJ_OPT_NUM_INT) && (s == S_MAGN_Z || s == S_MAGN_G))
+    {
+        if (num->exp10 == 0 && num->mant <= (uint64_t)INT64_MAX + num->neg)
+        {
+            token->flags |= PJ_NUM_INT;
+            token->val.i = num->neg ? -(int64_t)(num->mant - 1) - 1 : (int64_t)num->mant;
+            return;
+        }
+        if (!(parser->options & PJ_OPT_NUM_DOUBLE))
+        {
+            token->flags |= PJ_NUM_INT | PJ_NUM_OVERFLOW;
+            token->val.i = num->neg ? INT64_MIN : INT64_MAX;
+            return;
+        }
+        token->flags |= PJ_NUM_OVERFLOW;
+    }
+    if (parser->options & PJ_OPT_NUM_DOUBLE)
+    {
+        token->flags |= PJ_NUM_DOUBLE;
+        token->val.d = pj_num_to_double(num, token->str, token->len);
+    }
+}
+
 static bool pj_number_end(pj_parser_ref parser, pj_token *token, state s, const char *p)
 {
     TRACE_FUNC();
@@ -41,6 +71,8 @@ static bool pj_number_end(pj_parser_ref parser, pj_token *token, state s, const
         token->len = p - parser->chunk;
         pj_tok(parser, token, p, S_VALUE, PJ_TOK_NUM);
     }
+    if (parser->options & (PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE)) pj_number_value(parser, token, s);
+    memset(&parser->num, 0, sizeof(parser->num));
     return true;
 }
 
@@ -67,14 +99,18 @@ static bool pj_exponent_number(pj_parser_ref parser, pj_token *token, const char
 {
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
+    const bool decode = parser->options & PJ_OPT_NUM_DOUBLE;
+    struct pj_num_state num = parser->num;
 
     TRACE_PARSER(parser, p);
 
     for (;;)
     {
         TRACE_PARSER(parser, p);
+        if (!decode) p = pj_scan_digits(p, p_end, parser->chunk_pad);
         if (p == p_end)
         {
+            parser->num = num;
             pj_part_tok(parser, token, S_EXP_NUM, p);
             return false;
         }
@@ -82,6 +118,7 @@ static bool pj_exponent_number(pj_parser_ref parser, pj_token *token, const char
         switch (*p)
         {
         case '0' ... '9':
+            if (decode) pj_num_exp_digit(&num, *p);
             ++p;
             break;
         case 'e': case 'E': case '.': case '-': case '+':
@@ -89,6 +126,7 @@ static bool pj_exponent_number(pj_parser_ref parser, pj_token *token, const char
             return false;
 
         default:
+            parser->num = num;
             return pj_number_end(parser, token, S_EXP_NUM, p);
         }
     }
@@ -110,7 +148,7 @@ static bool pj_exponent_sign(pj_parser_ref parser, pj_token *token, const char *
     switch (*p)
     {
     case '0' ... '9':
-        return pj_exponent_number(parser, token, ++p);
+        return pj_exponent_number(parser, token, p);
 
     default:
         pj_err_tok(parser, token);
@@ -132,10 +170,13 @@ static bool pj_exponent_start(pj_parser_ref parser, pj_token *token, const char
 
     switch (*p)
     {
-    case '-': case '+':
+    case '-':
+        parser->num.exp_neg = 1;
+        /* fall through */
+    case '+':
         return pj_exponent_sign(parser, token, ++p);
     case '0' ... '9':
-        return pj_exponent_number(parser, token, ++p);
+        return pj_exponent_number(parser, token, p);
     case 'e': case 'E': case '.':
         pj_err_tok(parser, token);
         return false;
@@ -150,12 +191,16 @@ static bool pj_fraction_number(pj_parser_ref parser, pj_token *token, const char
 {
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
+    const bool decode = parser->options & PJ_OPT_NUM_DOUBLE;
+    struct pj_num_state num = parser->num;
 
     for (;;)
     {
         TRACE_PARSER(parser, p);
+        if (!decode) p = pj_scan_digits(p, p_end, parser->chunk_pad);
         if (p == p_end)
         {
+            parser->num = num;
             pj_part_tok(parser, token, S_FRAC_NUM, p);
             return false;
         }
@@ -163,15 +208,18 @@ static bool pj_fraction_number(pj_parser_ref parser, pj_token *token, const char
         switch (*p)
         {
         case '0' ... '9':
+            if (decode) pj_num_frac_digit(&num, *p);
             ++p;
             break;
         case 'e': case 'E':
+            parser->num = num;
             return pj_exponent_start(parser, token, ++p);
         case '-': case '+': case '.':
             pj_err_tok(parser, token);
             return false;
 
         default:
+            parser->num = num;
             return pj_number_end(parser, token, S_FRAC_NUM, p);
         }
     }
@@ -190,7 +238,7 @@ static bool pj_fraction_start(pj_parser_ref parser, pj_token *token, const char
 
     switch (*p)
     {
-    case '0' ... '9': return pj_fraction_number(parser, token, ++p);
+    case '0' ... '9': return pj_fraction_number(parser, token, p);
 
     default:
         pj_err_tok(parser, token);
@@ -202,12 +250,16 @@ static bool pj_magnitude_general(pj_parser_ref parser, pj_token *token, const ch
 {
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
+    const bool decode = parser->options & (PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE);
+    struct pj_num_state num = parser->num;
 
     for (;;)
     {
         TRACE_PARSER(parser, p);
+        if (!decode) p = pj_scan_digits(p, p_end, parser->chunk_pad);
         if (p == p_end)
         {
+            parser->num = num;
             pj_part_tok(parser, token, S_MAGN_G, p);
             return false;
         }
@@ -215,16 +267,20 @@ static bool pj_magnitude_general(pj_parser_ref parser, pj_token *token, const ch
         switch (*p)
         {
         case '0' ... '9':
+            if (decode) pj_num_int_digit(&num, *p);
             ++p;
             break;
         case '.':
+            parser->num = num;
             return pj_fraction_start(parser, token, ++p);
         case 'e': case 'E':
+            parser->num = num;
             return pj_exponent_start(parser, token, ++p);
         case '-': case '+':
             pj_err_tok(parser, token);
             return false;
         default:
+            parser->num = num;
             return pj_number_end(parser, token, S_MAGN_G, p);
         }
     }
@@ -272,7 +328,7 @@ static bool pj_magnitude_start(pj_parser_ref parser, pj_token *token, const char
     case '0':
         return pj_magnitude_zero(parser, token, ++p);
     case '1' ... '9':
-        return pj_magnitude_general(parser, token, ++p);
+        return pj_magnitude_general(parser, token, p);
     case '-': case '+': case '.': case 'e': case 'E':
         pj_err_tok(parser, token);
         return false;
@@ -285,7 +341,15 @@ static bool pj_magnitude_start(pj_parser_ref parser, pj_token *token, const char
 static bool pj_number(pj_parser_ref parser, pj_token *token, state s, const char *p)
 {
     TRACE_FUNC();
-    assert( p != parser->chunk_end );
+
+    if (p == parser->chunk_end)
+    {
+        /* empty chunk fed in the middle of number or restart after
+         * overflow of its tail
+         */
+        pj_part_tok(parser, token, s, p);
+        return false;
+    }
 
     switch (s)
     {
@@ -302,11 +366,12 @@ static bool pj_number(pj_parser_ref parser, pj_token *token, state s, const char
         switch (*p)
         {
         case '-':
+            parser->num.neg = 1;
             return pj_magnitude_start(parser, token, ++p);
         case '0':
             return pj_magnitude_zero(parser, token, ++p);
         case '1' ... '9':
-            return pj_magnitude_general(parser, token, ++p);
+            return pj_magnitude_general(parser, token, p);
         default:
             pj_err_tok(parser, token);
             return false;
@@ -0,0 +1,177 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_projection_h__
+#define __pjson_projection_h__
+
+#include "pjson.h"
+#include "pjson_state.h"
+#include "pjson_debug.h"
+
+/* Projection keeps set of paths (bit per path) that still match for each
+ * open container. Keys that match nothing are dropped together with their
+ * values (pj_skip_value() machinery), so are array items if no path has
+ * "*" there. Value matched by whole path is passed through as is.
+ */
+
+/* parse paths into components */
+static bool pj_proj_init(pj_projection *proj, const char * const *paths, size_t n)
+{
+    size_t i;
+
+    memset(proj, 0, sizeof(*proj));
+    if (n > PJ_PROJECTION_PATHS) return false;
+    proj->paths = paths;
+    for (i = 0; i < n; ++i)
+    {
+        const char *path = paths[i];
+        size_t k = 0, len = strlen(path);
+        size_t j;
+
+        if (len >= UINT16_MAX || (len > 0 && path[0] != '/')) return false;
+        for (j = 0; j < len; ++j)
+        {
+            if (path[j] != '/') continue;
+            if (k == PJ_PROJECTION_DEPTH) return false;
+            proj->comps[i][k++] = j + 1;
+        }
+        proj->comps[i][k] = len + 1;
+        proj->ncomps[i] = k;
+        proj->all |= (uint32_t)1 << i;
+    }
+    return true;
+}
+
+/* paths of set that complete at level (i.e. have that much components) */
+static uint32_t pj_proj_complete(const pj_projection *proj, uint32_t set, unsigned level)
+{
+    uint32_t complete = 0;
+    for (; set != 0; set &= set - 1)
+    {
+        const int i = __builtin_ctz(set);
+        if (proj->ncomps[i] == level) complete |= (uint32_t)1 << i;
+    }
+    return complete;
+}
+
+/* paths of set with component at level equal to str or "*" */
+static uint32_t pj_proj_match(const pj_projection *proj, uint32_t set, unsigned level,
+                              const char *str, size_t len)
+{
+    uint32_t match = 0;
+    for (; set != 0; set &= set - 1)
+    {
+        const int i = __builtin_ctz(set);
+        const char *comp = proj->paths[i] + proj->comps[i][level];
+        const size_t comp_len = proj->comps[i][level + 1] - proj->comps[i][level] - 1;
+
+        assert( level < proj->ncomps[i] );
+        if ((comp_len == 1 && comp[0] == '*') ||
+            (comp_len == len && memcmp(comp, str, len) == 0))
+        {
+            match |= (uint32_t)1 << i;
+        }
+    }
+    return match;
+}
+
+/* paths that may match value at depth */
+static uint32_t pj_proj_value_set(pj_parser_ref parser, unsigned depth)
+{
+    const pj_projection *proj = parser->proj;
+    const unsigned level = depth - 1;
+
+    if (depth == 0) return proj->all;
+    if (parser->nest[level / 64] & ((uint64_t)1 << (level % 64))) return proj->key_set;
+    return proj->sets[depth];
+}
+
+/* decide whether just polled token goes to client */
+static bool pj_proj_filter(pj_parser_ref parser, pj_token *token)
+{
+    pj_projection *proj = parser->proj;
+    const unsigned depth = token->depth;
+    uint32_t set;
+
+    if (proj->pass != 0)
+    {
+        /* inside of selected value */
+        if (depth + 1 == proj->pass && token->token_type != PJ_TOK_MAP && token->token_type != PJ_TOK_ARR)
+            proj->pass = 0;
+        return true;
+    }
+
+    switch (token->token_type)
+    {
+    case PJ_TOK_STR:
+        if (pj_state(parser) != S_COLON) break; /* not a key */
+        proj->key_set = pj_proj_match(proj, proj->sets[depth], depth - 1, token->str, token->len);
+        return proj->key_set != 0;
+
+    case PJ_TOK_KEY:
+        if (proj->key_set != 0) return true;
+        /* nothing to look for in value */
+        parser->skip.from = S_COMMA;
+        parser->state = S_SKIP;
+        return false;
+
+    case PJ_TOK_MAP_E:
+    case PJ_TOK_ARR_E:
+    case PJ_TOK_STR_PART: /* value is matched with its last piece */
+        return true;
+
+    default: ;
+    }
+
+    /* start of value */
+    set = pj_proj_value_set(parser, depth);
+    if (pj_proj_complete(proj, set, depth) != 0)
+    {
+        if (token->token_type == PJ_TOK_MAP || token->token_type == PJ_TOK_ARR) proj->pass = depth + 1;
+        return true;
+    }
+
+    switch (token->token_type)
+    {
+    case PJ_TOK_MAP:
+        proj->sets[depth + 1] = set;
+        break;
+    case PJ_TOK_ARR:
+        proj->sets[depth + 1] = pj_proj_match(proj, set, depth, "*", 1);
+        break;
+    default: ;
+    }
+    return true;
+}
+
+/* array item nobody is interested in? */
+static bool pj_proj_skip_item(pj_parser_ref parser, state s)
+{
+    const pj_projection *proj = parser->proj;
+    const unsigned depth = parser->depth;
+
+    if (proj->pass != 0 || depth == 0 || depth > PJ_PROJECTION_DEPTH || pj_in_map(parser)) return false;
+    if (proj->sets[depth] != 0) return false;
+
+    parser->skip.from = s;
+    parser->state = S_SKIP;
+    return true;
+}
+
+#endif
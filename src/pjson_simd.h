@@ -0,0 +1,248 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_simd_h__
+#define __pjson_simd_h__
+
+#include <stdint.h>
+#include <string.h>
+
+/* Kernels that look for "interesting" bytes several at once. Selected at
+ * build time from what target supports (e.g. -mavx2). Define PJ_NO_SIMD to
+ * force scalar code. Blocks are read up to p_pad (end of readable memory,
+ * see pj_feed_padded()), but nothing after p_end is reported.
+ */
+
+#if !defined(PJ_NO_SIMD) && defined(__AVX2__)
+#define PJ_SIMD_AVX2
+#define PJ_SIMD_SSE2
+#include <immintrin.h>
+#elif !defined(PJ_NO_SIMD) && defined(__SSE2__)
+#define PJ_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PJ_SIMD_SSE2) && defined(__SSSE3__)
+#define PJ_SIMD_SSSE3 /* byte shuffles (see pjson_utf8.h) */
+#include <tmmintrin.h>
+#endif
+
+#ifdef PJ_SIMD_AVX2
+/* mask of '"', '\\' and control chars (< 0x20) */
+static unsigned pj_str_mask32(const char *p)
+{
+    const __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i quote = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('"'));
+    const __m256i bslash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'));
+    const __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(0x1f)), x);
+    return _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(quote, bslash), ctrl));
+}
+
+/* mask of anything except '\t', '\n', '\r' and ' ' */
+static unsigned pj_nonspace_mask32(const char *p)
+{
+    const __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i sp = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '));
+    const __m256i tab = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'));
+    const __m256i nl = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'));
+    const __m256i cr = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'));
+    return ~_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(sp, tab), _mm256_or_si256(nl, cr)));
+}
+
+/* mask of '"', '/' and brackets */
+static unsigned pj_nest_mask32(const char *p)
+{
+    const __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i x20 = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+    const __m256i br = _mm256_or_si256(_mm256_cmpeq_epi8(x20, _mm256_set1_epi8('{')),
+                                       _mm256_cmpeq_epi8(x20, _mm256_set1_epi8('}')));
+    const __m256i other = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')),
+                                          _mm256_cmpeq_epi8(x, _mm256_set1_epi8('/')));
+    return _mm256_movemask_epi8(_mm256_or_si256(br, other));
+}
+#endif
+
+#ifdef PJ_SIMD_SSE2
+static unsigned pj_str_mask16(const char *p)
+{
+    const __m128i x = _mm_loadu_si128((const __m128i *)p);
+    const __m128i quote = _mm_cmpeq_epi8(x, _mm_set1_epi8('"'));
+    const __m128i bslash = _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'));
+    const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(0x1f)), x);
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, bslash), ctrl));
+}
+
+static unsigned pj_nonspace_mask16(const char *p)
+{
+    const __m128i x = _mm_loadu_si128((const __m128i *)p);
+    const __m128i sp = _mm_cmpeq_epi8(x, _mm_set1_epi8(' '));
+    const __m128i tab = _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'));
+    const __m128i nl = _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'));
+    const __m128i cr = _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'));
+    return ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(sp, tab), _mm_or_si128(nl, cr))) & 0xffff;
+}
+
+static unsigned pj_nest_mask16(const char *p)
+{
+    const __m128i x = _mm_loadu_si128((const __m128i *)p);
+    const __m128i x20 = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    const __m128i br = _mm_or_si128(_mm_cmpeq_epi8(x20, _mm_set1_epi8('{')),
+                                    _mm_cmpeq_epi8(x20, _mm_set1_epi8('}')));
+    const __m128i other = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')),
+                                       _mm_cmpeq_epi8(x, _mm_set1_epi8('/')));
+    return _mm_movemask_epi8(_mm_or_si128(br, other));
+}
+#endif
+
+/* first stop marked in mask of block at p or p_end if block crosses it
+ * (bytes after p_end are padding, see pj_feed_padded())
+ */
+static const char *pj_block_stop(const char *p, const char * const p_end, unsigned mask)
+{
+    return p + __builtin_ctz(mask | 1u << (p_end - p));
+}
+
+/* skip plain part of string body
+ * returns pointer to the first '"', '\\', control char or p_end
+ */
+static const char *pj_scan_str(const char *p, const char * const p_end, const char * const p_pad)
+{
+#ifdef PJ_SIMD_AVX2
+    for (; p_end - p >= 32; p += 32)
+    {
+        const unsigned mask = pj_str_mask32(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 32) return pj_block_stop(p, p_end, pj_str_mask32(p));
+#endif
+#ifdef PJ_SIMD_SSE2
+    for (; p_end - p >= 16; p += 16)
+    {
+        const unsigned mask = pj_str_mask16(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 16) return pj_block_stop(p, p_end, pj_str_mask16(p));
+#endif
+    (void) p_pad; /* scalar code goes byte by byte */
+    for (; p != p_end; ++p)
+    {
+        const unsigned char c = *p;
+        if (c == '"' || c == '\\' || c < 0x20) break;
+    }
+    return p;
+}
+
+/* skip white-space
+ * returns pointer to the first non-space char or p_end
+ */
+static const char *pj_scan_space(const char *p, const char * const p_end, const char * const p_pad)
+{
+#ifdef PJ_SIMD_AVX2
+    for (; p_end - p >= 32; p += 32)
+    {
+        const unsigned mask = pj_nonspace_mask32(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 32) return pj_block_stop(p, p_end, pj_nonspace_mask32(p));
+#endif
+#ifdef PJ_SIMD_SSE2
+    for (; p_end - p >= 16; p += 16)
+    {
+        const unsigned mask = pj_nonspace_mask16(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 16) return pj_block_stop(p, p_end, pj_nonspace_mask16(p));
+#endif
+    (void) p_pad; /* scalar code goes byte by byte */
+    for (; p != p_end; ++p)
+    {
+        switch (*p)
+        {
+        case '\t': case '\n': case '\r': case ' ':
+            break;
+        default:
+            return p;
+        }
+    }
+    return p;
+}
+
+/* skip contents of containers
+ * returns pointer to the first '"', '/', bracket or p_end
+ */
+static const char *pj_scan_nest(const char *p, const char * const p_end, const char * const p_pad)
+{
+#ifdef PJ_SIMD_AVX2
+    for (; p_end - p >= 32; p += 32)
+    {
+        const unsigned mask = pj_nest_mask32(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 32) return pj_block_stop(p, p_end, pj_nest_mask32(p));
+#endif
+#ifdef PJ_SIMD_SSE2
+    for (; p_end - p >= 16; p += 16)
+    {
+        const unsigned mask = pj_nest_mask16(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 16) return pj_block_stop(p, p_end, pj_nest_mask16(p));
+#endif
+    (void) p_pad; /* scalar code goes byte by byte */
+    for (; p != p_end; ++p)
+    {
+        switch (*p)
+        {
+        case '"': case '/': case '[': case ']': case '{': case '}':
+            return p;
+        default: ;
+        }
+    }
+    return p;
+}
+
+/* skip digits of number (8 at once with word loads)
+ * returns pointer to the first non-digit char or p_end
+ */
+static const char *pj_scan_digits(const char *p, const char * const p_end, const char * const p_pad)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (p_pad - p >= 8)
+    {
+        uint64_t x;
+        (void) memcpy(&x, p, sizeof(x));
+        /* non-zero bytes for chars other than '0' ... '9' (carry of +6 may
+         * spoil only bytes after first of them)
+         */
+        const uint64_t nondigit = ((x & 0xf0f0f0f0f0f0f0f0) ^ 0x3030303030303030) |
+                                  (((x + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) ^ 0x3030303030303030);
+        if (nondigit != 0)
+        {
+            p += __builtin_ctzll(nondigit) / 8;
+            return p < p_end ? p : p_end;
+        }
+        p += 8;
+        if (p >= p_end) return p_end;
+    }
+#endif
+    while (p != p_end && '0' <= *p && *p <= '9') ++p;
+    return p;
+}
+
+#endif
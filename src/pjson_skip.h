@@ -0,0 +1,190 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_skip_h__
+#define __pjson_skip_h__
+
+#include "pjson.h"
+#include "pjson_state.h"
+#include "pjson_space.h"
+#include "pjson_simd.h"
+#include "pjson_debug.h"
+
+/* Skipping of value only counts brackets and looks for quotes. Nothing is
+ * emitted or copied, so chunk can be dropped at any point. Like white-space
+ * (see pjson_space.h) functions return true once parser is moved past
+ * skipped part and false with terminal token.
+ */
+
+static void pj_skip_starving(pj_parser_ref parser, pj_token *token, state s, const char *p)
+{
+    parser->state = s;
+    parser->chunk = p;
+    parser->ptr = p;
+    token->token_type = PJ_STARVING;
+}
+
+/* value is over, continue with the next token */
+static bool pj_skip_end(pj_parser_ref parser, const char *p)
+{
+    TRACE_FUNC();
+    memset(&parser->skip, 0, sizeof(parser->skip));
+    parser->state = S_VALUE;
+    parser->chunk = p;
+    parser->ptr = p;
+    return true;
+}
+
+static bool pj_skip_str(pj_parser_ref parser, pj_token *token, const char *p);
+
+static bool pj_skip(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    const char * const p_end = parser->chunk_end;
+    unsigned depth = parser->skip.depth;
+
+    for (;;)
+    {
+        if (depth > 0) p = pj_scan_nest(p, p_end, parser->chunk_pad);
+        TRACE_PARSER(parser, p);
+        if (p == p_end)
+        {
+            parser->skip.depth = depth;
+            pj_skip_starving(parser, token, S_SKIP, p);
+            return false;
+        }
+
+        if (depth == 0 && parser->skip.started)
+        {
+            /* inside of scalar */
+            switch (*p)
+            {
+            case '0' ... '9': case 'a' ... 'z': case 'A' ... 'Z':
+            case '.': case '+': case '-':
+                ++p;
+                continue;
+            default:
+                return pj_skip_end(parser, p);
+            }
+        }
+
+        switch (*p)
+        {
+        case '"':
+            parser->skip.depth = depth;
+            parser->skip.started = 1;
+            if (!pj_skip_str(parser, token, p+1)) return false;
+            if (pj_state(parser) != S_SKIP) return true; /* it was the value */
+            p = parser->ptr;
+            break;
+        case '[': case '{':
+            ++depth;
+            parser->skip.started = 1;
+            ++p;
+            break;
+        case ']': case '}':
+            if (depth > 1)
+            {
+                --depth;
+                ++p;
+                break;
+            }
+            if (depth == 1) return pj_skip_end(parser, p+1);
+            if (*p == ']' && parser->skip.from == S_ARR)
+            {
+                /* empty array, no value to skip */
+                memset(&parser->skip, 0, sizeof(parser->skip));
+                parser->state = S_ARR;
+                parser->chunk = p;
+                parser->ptr = p;
+                return true;
+            }
+            pj_err_tok(parser, token);
+            return false;
+        case '/':
+            parser->skip.depth = depth;
+            return pj_comment_start(parser, token, p+1, S_SKIP);
+        case '\t': case '\n': case '\r': case ' ':
+            ++p;
+            break;
+        case ',': case ':':
+            if (depth == 0)
+            {
+                pj_err_tok(parser, token); /* no value */
+                return false;
+            }
+            ++p;
+            break;
+        default:
+            if (depth == 0) parser->skip.started = 1;
+            ++p;
+        }
+    }
+}
+
+static bool pj_skip_str(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    const char * const p_end = parser->chunk_end;
+
+    for (;;)
+    {
+        p = pj_scan_str(p, p_end, parser->chunk_pad);
+        TRACE_PARSER(parser, p);
+        if (p == p_end)
+        {
+            pj_skip_starving(parser, token, S_SKIP_STR, p);
+            return false;
+        }
+
+        switch (*p)
+        {
+        case '"':
+            if (parser->skip.depth == 0) return pj_skip_end(parser, p+1);
+            /* back to container */
+            parser->state = S_SKIP;
+            parser->chunk = p+1;
+            parser->ptr = p+1;
+            return true;
+        case '\\':
+            if (++p == p_end)
+            {
+                pj_skip_starving(parser, token, S_SKIP_ESC, p);
+                return false;
+            }
+            ++p;
+            break;
+        default:
+            ++p; /* control char */
+        }
+    }
+}
+
+static bool pj_skip_esc(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    if (p == parser->chunk_end)
+    {
+        pj_skip_starving(parser, token, S_SKIP_ESC, p);
+        return false;
+    }
+    return pj_skip_str(parser, token, p+1);
+}
+
+#endif
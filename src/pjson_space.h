@@ -22,6 +22,13 @@
 
 #include "pjson.h"
 #include "pjson_general.h"
+#include "pjson_simd.h"
+
+/* White-space and comments produce no tokens: functions below return true
+ * once parser is moved past them (pj_poll_tok() goes on from there in its
+ * loop instead of being called again, so stack doesn't grow with number of
+ * comments at any optimization level) and false with terminal token.
+ */
 
 static bool pj_comment_line(pj_parser_ref parser, pj_token *token, const char *p, state s)
 {
@@ -46,16 +53,15 @@ static bool pj_comment_line(pj_parser_ref parser, pj_token *token, const char *p
             parser->ptr = p+1;
             parser->chunk = p+1;
             parser->state = s;
-            return pj_poll_tok(parser, token);
+            return true;
         default:
             ++p;
         }
     }
 }
 
-static bool pj_comment_end(pj_parser_ref parser, pj_token *token, const char *p, state s);
-
-static bool pj_comment_region(pj_parser_ref parser, pj_token *token, const char *p, state s)
+/* inside of comment region (star if previous char is '*') */
+static bool pj_comment_region(pj_parser_ref parser, pj_token *token, const char *p, state s, bool star)
 {
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
@@ -66,35 +72,7 @@ static bool pj_comment_region(pj_parser_ref parser, pj_token *token, const char
         {
             parser->ptr = p;
             parser->chunk = p;
-            parser->state = S_COMMENT_REGION;
-            parser->state0 = s;
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-
-        switch (*p)
-        {
-        case '*':
-            return pj_comment_end(parser, token, p+1, s);
-
-        default:
-            ++p;
-        }
-    }
-}
-
-static bool pj_comment_end(pj_parser_ref parser, pj_token *token, const char *p, state s)
-{
-    TRACE_FUNC();
-    const char * const p_end = parser->chunk_end;
-
-    for (;;)
-    {
-        if (p == p_end)
-        {
-            parser->ptr = p;
-            parser->chunk = p;
-            parser->state = S_COMMENT_END;
+            parser->state = star ? S_COMMENT_END : S_COMMENT_REGION;
             parser->state0 = s;
             token->token_type = PJ_STARVING;
             return false;
@@ -103,16 +81,21 @@ static bool pj_comment_end(pj_parser_ref parser, pj_token *token, const char *p,
         switch (*p)
         {
         case '*':
+            star = true;
             ++p;
             break;
         case '/':
-            parser->ptr = p+1;
-            parser->chunk = p+1;
-            parser->state = s;
-            return pj_poll_tok(parser, token);
-
+            if (star)
+            {
+                parser->ptr = p+1;
+                parser->chunk = p+1;
+                parser->state = s;
+                return true;
+            }
+            /* fall through */
         default:
-            return pj_comment_region(parser, token, p+1, s);
+            star = false;
+            ++p;
         }
     }
 }
@@ -122,29 +105,26 @@ static bool pj_comment_start(pj_parser_ref parser, pj_token *token, const char *
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
 
-    for (;;)
+    if (p == p_end)
     {
-        if (p == p_end)
-        {
-            parser->ptr = p;
-            parser->chunk = p;
-            parser->state = S_COMMENT_START;
-            parser->state0 = s;
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-
-        switch (*p)
-        {
-        case '*':
-            return pj_comment_region(parser, token, p+1, s);
-        case '/':
-            return pj_comment_line(parser, token, p+1, s);
+        parser->ptr = p;
+        parser->chunk = p;
+        parser->state = S_COMMENT_START;
+        parser->state0 = s;
+        token->token_type = PJ_STARVING;
+        return false;
+    }
 
-        default:
-            pj_err_tok(parser, token);
-            return false;
-        }
+    switch (*p)
+    {
+    case '*':
+        return pj_comment_region(parser, token, p+1, s, false);
+    case '/':
+        return pj_comment_line(parser, token, p+1, s);
+
+    default:
+        pj_err_tok(parser, token);
+        return false;
     }
 }
 
@@ -153,31 +133,22 @@ static bool pj_space(pj_parser_ref parser, pj_token *token, const char *p, state
     TRACE_FUNC();
     const char * const p_end = parser->chunk_end;
 
-    for (;;)
+    p = pj_scan_space(p, p_end, parser->chunk_pad);
+    if (p == p_end)
     {
-        if (p == p_end)
-        {
-            parser->ptr = p;
-            parser->chunk = p;
-            parser->state = s;
-            token->token_type = PJ_STARVING;
-            return false;
-        }
-
-        switch (*p)
-        {
-        case '\t': case '\n': case '\r': case ' ':
-            ++p;
-            break;
-        case '/':
-            return pj_comment_start(parser, token, p+1, s);
-        default:
-            parser->ptr = p;
-            parser->chunk = p;
-            parser->state = s;
-            return pj_poll_tok(parser, token);
-        }
+        parser->ptr = p;
+        parser->chunk = p;
+        parser->state = s;
+        token->token_type = PJ_STARVING;
+        return false;
     }
+
+    if (*p == '/') return pj_comment_start(parser, token, p+1, s);
+
+    parser->ptr = p;
+    parser->chunk = p;
+    parser->state = s;
+    return true;
 }
 
 #endif
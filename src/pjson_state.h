@@ -27,8 +27,12 @@ typedef enum {
     S_INIT = 0,
     S_ERR,
     S_END,
-    S_VALUE,
-    S_COMMA,
+    S_VALUE, /* after value */
+    S_COMMA, /* value expected (after ',' in array or ':' in map) */
+    S_ARR, /* value or ']' expected */
+    S_MAP, /* key or '}' expected */
+    S_KEY, /* key expected (after ',' in map) */
+    S_COLON, /* after key */
     S_N, S_NU, S_NUL,
     S_T, S_TR, S_TRU,
     S_F, S_FA, S_FAL, S_FALS,
@@ -43,7 +47,9 @@ typedef enum {
     S_STR, S_ESC,
     S_UNICODE, S_UNICODE_FINISH = S_UNICODE + 4, /* 4 hex digits */
     S_UNICODE_ESC, /* handle surrogate pairs */
-    S_STR_VALUE, /* str may end up as key */
+
+    /* skipping value (see pj_skip_value()) */
+    S_SKIP, S_SKIP_STR, S_SKIP_ESC,
 
     /* other stuff */
     S_COMMENT_START, S_COMMENT_LINE, S_COMMENT_REGION, S_COMMENT_END,
@@ -51,6 +57,7 @@ typedef enum {
 
 #define F_BUF 0x100
 #define F_END 0x200
+#define F_ESC 0x400 /* string slice since parser->chunk has escapes to decode */
 
 /* state manipulation */
 static state pj_state(pj_parser_ref parser)
@@ -77,14 +84,116 @@ static void pj_set_end(pj_parser_ref parser)
     }
 }
 
+/* nesting stack */
+static bool pj_in_map(pj_parser_ref parser)
+{
+    const unsigned top = parser->depth - 1;
+    return parser->depth > 0 && (parser->nest[top / 64] & ((uint64_t)1 << (top % 64)));
+}
+
+static void pj_push(pj_parser_ref parser, bool map)
+{
+    const unsigned depth = parser->depth;
+    const uint64_t bit = (uint64_t)1 << (depth % 64);
+
+    assert( depth < PJ_MAX_DEPTH );
+    if (map) parser->nest[depth / 64] |= bit;
+    else parser->nest[depth / 64] &= ~bit;
+    parser->depth = depth + 1;
+}
+
+/* Buffer owned by parser (see pj_init_alloc()) lives in block that starts
+ * with pointer to previous block. Grown buffer gets copy of everything
+ * (offsets of compact tokens stay valid), but previous blocks are kept till
+ * next poll since tokens handed out already point into them.
+ */
+#define PJ_BUF_HEAD sizeof(void *)
+#define PJ_BUF_MIN 256
+
+/* there may be no buffer at all (NULL) till one is grown or borrowed from
+ * pool (see pj_init_pool()), so its pointers are subtracted only after check
+ */
+static size_t pj_buf_used(pj_parser_ref parser)
+{
+    return parser->buf == NULL ? 0 : (size_t)(parser->buf_ptr - parser->buf);
+}
+
+static size_t pj_buf_room(pj_parser_ref parser)
+{
+    return parser->buf == NULL ? 0 : (size_t)(parser->buf_end - parser->buf_ptr);
+}
+
+static bool pj_grow(pj_parser_ref parser, size_t len)
+{
+    const pj_allocator * const alloc = parser->alloc;
+    char * const old = parser->buf;
+    const size_t used = pj_buf_used(parser);
+    size_t size = 2 * (used + pj_buf_room(parser));
+
+    if (size < PJ_BUF_MIN) size = PJ_BUF_MIN;
+    if (size < used + len) size = used + len;
+
+    char * const block = alloc->alloc(alloc->ctx, PJ_BUF_HEAD + size);
+    if (block == NULL) return false;
+    TRACEF("grown buffer to %zd bytes", size);
+
+    char * const buf = block + PJ_BUF_HEAD;
+    void * const prev = old == NULL ? NULL : old - PJ_BUF_HEAD;
+    (void) memcpy(block, &prev, sizeof(prev));
+    if (used > 0) (void) memcpy(buf, old, used);
+
+    if (old <= parser->key_str && parser->key_str <= parser->buf_ptr)
+        parser->key_str = buf + (parser->key_str - old);
+    parser->buf_last = old == NULL ? buf : buf + (parser->buf_last - old);
+    parser->buf_ptr = buf + used;
+    parser->buf = buf;
+    parser->buf_end = buf + size;
+    return true;
+}
+
+/* take block from pool for buffer that is released with pj_give_back() */
+static bool pj_borrow(pj_parser_ref parser, size_t len)
+{
+    pj_pool * const pool = parser->pool;
+    char * const block = pool->free;
+
+    if (parser->buf != NULL || block == NULL || len > pool->block_len) return false;
+    (void) memcpy(&pool->free, block, sizeof(pool->free));
+    --pool->nfree;
+    TRACEF("borrowed buffer (%zd left)", pool->nfree);
+
+    parser->buf = block;
+    parser->buf_end = block + pool->block_len;
+    parser->buf_ptr = block;
+    parser->buf_last = block;
+    return true;
+}
+
+static void pj_give_back(pj_parser_ref parser)
+{
+    pj_pool * const pool = parser->pool;
+    char * const block = parser->buf;
+
+    (void) memcpy(block, &pool->free, sizeof(pool->free));
+    pool->free = block;
+    ++pool->nfree;
+    TRACEF("returned buffer (%zd left)", pool->nfree);
+
+    parser->buf = parser->buf_end = parser->buf_ptr = NULL;
+    parser->buf_last = NULL;
+}
+
 static bool pj_reserve(pj_parser_ref parser, pj_token *token, size_t len, const char *p)
 {
-    char * buf_ptr1 = parser->buf_ptr + len;
-    if (buf_ptr1 > parser->buf_end)
+    const size_t room = pj_buf_room(parser);
+    if (len > room)
     {
-        TRACEF("overflow required %ld more", buf_ptr1 - parser->buf_end);
+        if (parser->alloc != NULL && pj_grow(parser, len)) return true;
+        if (parser->pool != NULL && pj_borrow(parser, len)) return true;
+
+        TRACEF("overflow required %zd more", len - room);
         token->token_type = PJ_OVERFLOW;
-        token->len = buf_ptr1 - parser->buf;
+        token->len = pj_buf_used(parser) + len;
         parser->ptr = p;
         return false;
     }
@@ -117,9 +226,16 @@ static void pj_part_tok(pj_parser_ref parser, pj_token *token, state s, const ch
     assert( p == parser->chunk_end );
     assert( !pj_use_buf(parser) || (parser->buf <= parser->buf_last && parser->buf_last <= parser->buf_ptr) );
 
-    parser->state = s;
+    parser->state = s | (parser->state & F_BUF); /* keep what's already in buffer */
     if (p > parser->chunk)
     {
+        if ((parser->options & PJ_OPT_CONTIGUOUS) && !pj_use_buf(parser))
+        {
+            /* stays in input till completion (see pj_feed()) */
+            parser->ptr = p;
+            token->token_type = PJ_STARVING;
+            return;
+        }
         if (!pj_add_chunk(parser, token, p)) return;
         parser->state |= F_BUF;
     }
@@ -141,6 +257,8 @@ static void pj_tok(pj_parser_ref parser, pj_token *token,
     parser->chunk = p;
     parser->state = pj_new_state(parser, s) & ~F_BUF;
     token->token_type = tok;
+    token->flags = 0;
+    token->depth = parser->depth;
 }
 
 static bool pj_buf_tok(pj_parser_ref parser, pj_token *token,
@@ -20,33 +20,359 @@
 #ifndef __pjson_string_h__
 #define __pjson_string_h__
 
-#include <errno.h>
 #include <string.h>
 #include <arpa/inet.h>
 
 #include "pjson.h"
 #include "pjson_state.h"
+#include "pjson_simd.h"
+#include "pjson_utf8.h"
 #include "pjson_debug.h"
 
 static bool pj_string_esc(pj_parser_ref parser, pj_token *token, const char *p);
+static bool pj_string_slice(pj_parser_ref parser, pj_token *token, const char *p);
 static bool pj_unicode(pj_parser_ref parser, pj_token *token, const char *p);
 static bool pj_unicode_esc(pj_parser_ref parser, pj_token *token, const char *p);
 
-static bool pj_string(pj_parser_ref parser, pj_token *token, const char *p)
+/* Escapes don't force copying of string as soon as they met. Lexer only
+ * remembers that slice [parser->chunk, p) has them (F_ESC) and decodes
+ * whole slice into buffer at once when string ends or chunk is over. Escape
+ * that is cut by the end of chunk is decoded char by char with S_ESC and
+ * S_UNICODE states as before.
+ */
+
+/* value of hex digit + 1 (0 for other chars) */
+static const uint8_t pj_hex[256] = {
+    ['0'] = 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+    ['A'] = 11, 12, 13, 14, 15, 16,
+    ['a'] = 11, 12, 13, 14, 15, 16,
+};
+
+static int pj_hex4(const char *p)
+{
+    const int h0 = pj_hex[(uint8_t)p[0]] - 1, h1 = pj_hex[(uint8_t)p[1]] - 1,
+              h2 = pj_hex[(uint8_t)p[2]] - 1, h3 = pj_hex[(uint8_t)p[3]] - 1;
+    if ((h0 | h1 | h2 | h3) < 0) return -1;
+    return h0 << 12 | h1 << 8 | h2 << 4 | h3;
+}
+
+/* encode code point c (up to 0x10ffff) as UTF-8 into out
+ * returns number of bytes written
+ */
+static size_t pj_utf8(char *out, uint32_t c)
+{
+    static const uint8_t lead[PJ_UTF8_MAX + 1] = { 0, 0, 0xc0, 0xe0, 0xf0 };
+    const size_t n = 1 + (c >= 0x80) + (c >= 0x800) + (c >= 0x10000);
+    size_t i;
+
+    for (i = n - 1; i > 0; --i, c >>= 6) out[i] = 0x80 | (c & 0x3f);
+    out[0] = lead[n] | c;
+    return n;
+}
+
+/* code point of \uXXXX escape (or surrogate pair of them) at *s, advances *s
+ * returns -1 for invalid escape and -2 if it is cut by the end
+ */
+static int32_t pj_unicode_at(const char **s, const char *end)
+{
+    const char *p = *s;
+    if (end - p < 6) return -2;
+    const int c16 = pj_hex4(p + 2);
+    if (c16 < 0 || (0xdc00 <= c16 && c16 <= 0xdfff)) return -1; /* or lone low surrogate */
+    if (c16 < 0xd800 || c16 > 0xdbff)
+    {
+        *s = p + 6;
+        return c16;
+    }
+
+    /* surrogate pair */
+    if (end - p < 12) return -2;
+    const int low = p[6] == '\\' && p[7] == 'u' ? pj_hex4(p + 8) : -1;
+    if (low < 0xdc00 || low > 0xdfff) return -1;
+    *s = p + 12;
+    return 0x010000 + ((c16 - 0xd800) << 10) + (low - 0xdc00);
+}
+
+/* append len bytes of block at out + *n if they fit before out_end */
+static void pj_unescape_put(char *out, const char *out_end, size_t *n, const char *block, size_t len)
+{
+    const size_t room = out_end - out;
+    if (*n < room) (void) memcpy(out + *n, block, len < room - *n ? len : room - *n);
+    *n += len;
+}
+
+/* decode slice [s, end) into out (writes only what fits before out_end) and
+ * put length of decoded slice into len; stops before escape cut by the end
+ * returns where it stopped or NULL for invalid escape
+ */
+static const char *pj_unescape_slice(const char *s, const char *end,
+                                     char *out, const char *out_end, size_t *len)
+{
+    size_t n = 0;
+    for (;;)
+    {
+        const char *esc = memchr(s, '\\', end - s);
+        if (esc == NULL) esc = end;
+        pj_unescape_put(out, out_end, &n, s, esc - s);
+        s = esc;
+        *len = n;
+        if (end - s < 2) return s;
+
+        char c;
+        switch (s[1])
+        {
+        case '"': case '/': case '\\': c = s[1]; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 't': c = '\t'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+
+        case 'u':
+            /* run of unicode escapes (e.g. non-latin text) in one go */
+            do
+            {
+                const int32_t cp = pj_unicode_at(&s, end);
+                if (cp == -1) return NULL;
+                if (cp == -2) return s;
+                if ((size_t)(out_end - out) >= n + PJ_UTF8_MAX)
+                {
+                    n += pj_utf8(out + n, cp);
+                }
+                else
+                {
+                    char mb[PJ_UTF8_MAX];
+                    pj_unescape_put(out, out_end, &n, mb, pj_utf8(mb, cp));
+                }
+                *len = n;
+            } while (end - s >= 2 && s[0] == '\\' && s[1] == 'u');
+            continue;
+
+        default: return NULL;
+        }
+        pj_unescape_put(out, out_end, &n, &c, 1);
+        s += 2;
+    }
+}
+
+/* is string split into PJ_TOK_STR_PART pieces? */
+static bool pj_str_parts(pj_parser_ref parser)
+{
+    return (parser->options & PJ_OPT_STR_PARTS) && parser->state0 != S_COLON;
+}
+
+/* is string value handed out without unescaping (see PJ_OPT_RAW_STR)? */
+static bool pj_str_raw(pj_parser_ref parser)
+{
+    return (parser->options & PJ_OPT_RAW_STR) && parser->state0 != S_COLON;
+}
+
+/* string cut by the end of chunk: hand out what's formed so far as
+ * PJ_TOK_STR_PART (raw slice of chunk or decoded piece in buffer) and keep
+ * only the rest of string for PJ_TOK_STR
+ * returns true if there is a piece
+ */
+static bool pj_str_part_tok(pj_parser_ref parser, pj_token *token, state s, const char *p)
 {
     TRACE_FUNC();
-    assert( parser->str.c == 0 && mbsinit(&parser->str.s) );
+    if (!pj_str_parts(parser))
+    {
+        pj_part_tok(parser, token, s, p);
+        return false;
+    }
+
+    if (pj_use_buf(parser))
+    {
+        /* pending escape isn't lost if piece has to wait for bigger buffer */
+        parser->state = s | (parser->state & F_BUF);
+        if (!pj_add_chunk(parser, token, p)) return false;
+        token->str = parser->buf_last;
+        token->len = parser->buf_ptr - parser->buf_last;
+        parser->buf_last = parser->buf_ptr;
+    }
+    else
+    {
+        token->str = parser->chunk;
+        token->len = p - parser->chunk;
+    }
+    parser->state = s; /* F_BUF only for pending escape */
+    parser->chunk = p;
+    parser->ptr = p;
+    if (token->len == 0)
+    {
+        token->token_type = PJ_STARVING;
+        return false;
+    }
+    token->token_type = PJ_TOK_STR_PART;
+    token->flags = 0;
+    token->depth = parser->depth;
+    return true;
+}
+
+/* move decoded slice [parser->chunk, p) into buffer (cut if it ends with
+ * escaping backslash)
+ */
+static const char *pj_string_unescape(pj_parser_ref parser, pj_token *token, const char *p, bool cut)
+{
+    TRACE_FUNC();
+    size_t len;
+    const char *stop = pj_unescape_slice(parser->chunk, p, parser->buf_ptr, parser->buf_end, &len);
+    if (stop == NULL)
+    {
+        pj_err_tok(parser, token);
+        return NULL;
+    }
+    /* in case of restart from overflow, backslash cut by the end of chunk is
+     * remembered until slice is in buffer (see pj_string_esc())
+     */
+    parser->state = pj_new_state(parser, cut ? S_ESC : S_STR);
+    if (len > pj_buf_room(parser))
+    {
+        if (!pj_reserve(parser, token, len, p)) return NULL;
+        /* buffer is grown (see pj_init_alloc()) */
+        (void) pj_unescape_slice(parser->chunk, p, parser->buf_ptr, parser->buf_end, &len);
+    }
+    parser->buf_ptr += len;
+    parser->chunk = stop;
+    parser->state = (parser->state & ~F_ESC) | F_BUF;
+    return stop;
+}
+
+/* end of chunk within slice with escapes; cut if it ends with escaping
+ * backslash
+ */
+static bool pj_string_slice_end(pj_parser_ref parser, pj_token *token, const char *p, bool cut)
+{
+    TRACE_FUNC();
+    if (pj_str_raw(parser) && !pj_str_parts(parser))
+    {
+        /* raw slice is kept as is, backslash cut by the end of chunk makes
+         * next char escaped (see pj_string_esc())
+         */
+        pj_part_tok(parser, token, (cut ? S_ESC : S_STR) | F_ESC, p);
+        return false;
+    }
+    if ((parser->options & PJ_OPT_CONTIGUOUS) && !cut && !pj_str_parts(parser))
+    {
+        /* slice stays in input and is decoded at closing quote */
+        parser->ptr = p;
+        token->token_type = PJ_STARVING;
+        return false;
+    }
+
+    const char *stop = pj_string_unescape(parser, token, p, cut);
+    if (stop == NULL) return false;
+    if (stop != p)
+    {
+        /* escape cut by the end of chunk */
+        parser->state = S_ESC | F_BUF;
+        return pj_string_esc(parser, token, stop + 1);
+    }
+    return pj_str_part_tok(parser, token, S_STR, p);
+}
+
+/* raw slice [parser->chunk, p) (or whole string in buffer) with escapes */
+static bool pj_string_raw_tok(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    if (pj_use_buf(parser))
+    {
+        if (!pj_buf_tok(parser, token, p, p+1, parser->state0, PJ_TOK_STR)) return false;
+    }
+    else
+    {
+        token->str = parser->chunk;
+        token->len = p - parser->chunk;
+        pj_tok(parser, token, p+1, parser->state0, PJ_TOK_STR);
+    }
+    parser->state &= ~F_ESC;
+    token->flags = PJ_STR_ESC;
+    return true;
+}
+
+/* skip plain part of string body (checking UTF-8 if asked) */
+static const char *pj_string_next(pj_parser_ref parser, const char *p)
+{
+    if (parser->options & PJ_OPT_UTF8) return pj_next_str_stop_utf8(parser, p);
+    return pj_scan_str(p, parser->chunk_end, parser->chunk_pad);
+}
+
+/* rest of string after escape (slice since parser->chunk has F_ESC) */
+static bool pj_string_slice(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    assert( parser->str.c == 0 );
+    assert( parser->state & F_ESC );
 
     const char * const p_end = parser->chunk_end;
+    const char *stop;
+    if (parser->str.tail_len != 0 && !pj_utf8_resume(parser, &p))
+    {
+        pj_err_tok(parser, token);
+        return false;
+    }
 
     for (;;)
     {
+        p = pj_string_next(parser, p);
         TRACE_PARSER(parser, p);
-        if (p == p_end)
+        if (p == p_end) return pj_string_slice_end(parser, token, p, false);
+
+        switch (*p)
         {
-            pj_part_tok(parser, token, S_STR, p);
+        case '"':
+            if (pj_str_raw(parser) && (!pj_str_parts(parser) || !pj_use_buf(parser)))
+                return pj_string_raw_tok(parser, token, p);
+            /* token is set for NULL, stop before quote is escape cut by it */
+            stop = pj_string_unescape(parser, token, p, false);
+            if (stop == NULL) return false;
+            if (stop != p)
+            {
+                pj_err_tok(parser, token);
+                return false;
+            }
+            return pj_buf_tok(parser, token, p, p+1, parser->state0, PJ_TOK_STR);
+
+        case '\\':
+            if (++p == p_end) return pj_string_slice_end(parser, token, p, true);
+            ++p;
+            break;
+
+#ifndef JSON_RELAXED
+        case '\b': case '\f': case '\t': case '\n': case '\r':
+            /* control characters are disallowed in JSON */
+            pj_err_tok(parser, token);
             return false;
+#endif
+
+        case '\x80' ... '\xff':
+            /* invalid UTF-8 (see PJ_OPT_UTF8) */
+            pj_err_tok(parser, token);
+            return false;
+
+        default: ++p;
         }
+    }
+    /* unreachable */
+}
+
+static bool pj_string(pj_parser_ref parser, pj_token *token, const char *p)
+{
+    TRACE_FUNC();
+    assert( parser->str.c == 0 );
+
+    const char * const p_end = parser->chunk_end;
+    if (parser->str.tail_len != 0 && !pj_utf8_resume(parser, &p))
+    {
+        pj_err_tok(parser, token);
+        return false;
+    }
+
+    for (;;)
+    {
+        p = pj_string_next(parser, p);
+        TRACE_PARSER(parser, p);
+        if (p == p_end) return pj_str_part_tok(parser, token, S_STR, p);
 
         switch (*p)
         {
@@ -54,26 +380,23 @@ static bool pj_string(pj_parser_ref parser, pj_token *token, const char *p)
             if (pj_use_buf(parser))
             {
                 parser->state = pj_new_state(parser, S_STR); /* in case of restart from overflow */
-                return pj_buf_tok(parser, token, p, p+1, S_STR_VALUE, PJ_TOK_STR);
+                return pj_buf_tok(parser, token, p, p+1, parser->state0, PJ_TOK_STR);
             }
             else
             {
                 token->str = parser->chunk;
                 token->len = p - parser->chunk;
-                pj_tok(parser, token, ++p, S_STR_VALUE, PJ_TOK_STR);
+                pj_tok(parser, token, ++p, parser->state0, PJ_TOK_STR);
                 return true;
             }
             /* unreachable */
             break;
 
         case '\\':
-            if (!pj_add_chunk(parser, token, p))
-            {
-                parser->state = pj_new_state(parser, S_STR); /* remember our state */
-                return false;
-            }
-            parser->state = S_ESC | F_BUF;
-            return pj_string_esc(parser, token, ++p);
+            /* decoded later along with the rest of slice */
+            parser->state = pj_new_state(parser, S_STR) | F_ESC;
+            if (++p == p_end) return pj_string_slice_end(parser, token, p, true);
+            return pj_string_slice(parser, token, ++p);
 
 #ifndef JSON_RELAXED
         case '\b': case '\f': case '\t': case '\n': case '\r':
@@ -82,6 +405,11 @@ static bool pj_string(pj_parser_ref parser, pj_token *token, const char *p)
             return false;
 #endif
 
+        case '\x80' ... '\xff':
+            /* invalid UTF-8 (see PJ_OPT_UTF8) */
+            pj_err_tok(parser, token);
+            return false;
+
         default: ++p;
         }
     }
@@ -91,13 +419,22 @@ static bool pj_string(pj_parser_ref parser, pj_token *token, const char *p)
 static bool pj_string_esc(pj_parser_ref parser, pj_token *token, const char *p)
 {
     TRACE_FUNC();
-    assert( parser->str.c == 0 && mbsinit(&parser->str.s) );
+    assert( parser->str.c == 0 );
 
     const char * const p_end = parser->chunk_end;
+    if (parser->state & F_ESC)
+    {
+        /* char after backslash of raw string is taken as is (slice with
+         * backslash cut is either kept or moved into buffer again)
+         */
+        if (p == p_end) return pj_string_slice_end(parser, token, p, true);
+        parser->state = pj_new_state(parser, S_STR);
+        return pj_string_slice(parser, token, p+1);
+    }
     if (p == p_end)
     {
-        pj_part_tok(parser, token, S_ESC, p);
-        return false;
+        parser->chunk = p; /* preceding part is already in buffer */
+        return pj_str_part_tok(parser, token, S_ESC | F_BUF, p);
     }
 
     parser->chunk = p;
@@ -107,7 +444,9 @@ static bool pj_string_esc(pj_parser_ref parser, pj_token *token, const char *p)
     {
     /* guarded chars */
     case '"': case '/': case '\\':
-        return pj_string(parser, token, ++p);
+        if (!pj_add_block(parser, token, p, 1, p)) return false;
+        parser->chunk = ++p;
+        return pj_string(parser, token, p);
 
     /* special chars */
     case 'b':
@@ -153,11 +492,18 @@ static bool pj_unicode(pj_parser_ref parser, pj_token *token, const char *p)
         {
             c = c | c16;
             parser->str.c = c;
-            pj_part_tok(parser, token, (S_UNICODE + n) | F_BUF, p);
-            return false;
+            parser->chunk = p; /* escape is accounted in str.c */
+            return pj_str_part_tok(parser, token, (S_UNICODE + n) | F_BUF, p);
         }
         if (n == 4)
         {
+            const bool low = 0xdc00 <= c16 && c16 <= 0xdfff;
+            if ((c & ~0xffff) ? !low : low)
+            {
+                /* high surrogate without low one or vice versa */
+                pj_err_tok(parser, token);
+                return false;
+            }
             bool surrogate = 0xd800 <= c16 && c16 <= 0xdbff;
             if (surrogate) /* surrogate pair */
             {
@@ -166,26 +512,11 @@ static bool pj_unicode(pj_parser_ref parser, pj_token *token, const char *p)
             }
             else
             {
-                wchar_t wc;
+                uint32_t cp = c16;
                 if (c & ~0xffff) /* this is surrogate pair */
-                {
-                    wc = ((c >> 16) - 0xd800) << 10;
-                    wc |= c16 - 0xdc00;
-                    wc += 0x010000;
-                }
-                else
-                {
-                    wc = c16;
-                }
-                /* flush wchar */
-                size_t encoded = wcrtomb(parser->buf_ptr, wc, &parser->str.s);
-                if (encoded == (size_t)-1)
-                {
-                    TRACEF("invalid unicode: (errno=#%d) %s", errno, strerror(errno));
-                    pj_err_tok(parser, token);
-                    return false;
-                }
-                TRACEF("wc = %04x (%C) encoded into %ld bytes", wc, wc, encoded);
+                    cp = 0x010000 + (((c >> 16) - 0xd800) << 10) + (c16 - 0xdc00);
+                const size_t encoded = pj_utf8(parser->buf_ptr, cp);
+                TRACEF("code point %04x encoded into %zd bytes", cp, encoded);
                 parser->buf_ptr += encoded;
                 parser->str.c = 0;
             }
@@ -202,7 +533,6 @@ static bool pj_unicode(pj_parser_ref parser, pj_token *token, const char *p)
                     return false;
                 }
                 parser->chunk = p;
-                parser->str.s = (mbstate_t) { 0 }; /* reset multibyte state */
                 return pj_string(parser, token, p);
             }
         }
@@ -231,13 +561,13 @@ static bool pj_unicode_esc(pj_parser_ref parser, pj_token *token, const char *p)
     const char * const p_end = parser->chunk_end;
     if (p == p_end)
     {
-        pj_part_tok(parser, token, S_UNICODE_ESC | F_BUF, p);
-        return false;
+        parser->chunk = p;
+        return pj_str_part_tok(parser, token, S_UNICODE_ESC | F_BUF, p);
     }
     switch (*p)
     {
     case 'u':
-        if (!pj_reserve(parser, token, MB_CUR_MAX, p))
+        if (!pj_reserve(parser, token, PJ_UTF8_MAX, p))
         {
             parser->state = S_UNICODE_ESC | F_BUF;
             return false;
@@ -245,10 +575,13 @@ static bool pj_unicode_esc(pj_parser_ref parser, pj_token *token, const char *p)
         parser->state = S_UNICODE | F_BUF;
         return pj_unicode(parser, token, ++p);
     default:
+        if (parser->str.c != 0)
+        {
+            /* high surrogate without low one */
+            pj_err_tok(parser, token);
+            return false;
+        }
         parser->state = S_ESC | F_BUF;
-        /* reset multibyte state */
-        parser->str.c = 0;
-        parser->str.s = (mbstate_t) { 0 };
         return pj_string_esc(parser, token, p);
     }
 }
@@ -0,0 +1,356 @@
+/*
+ * pjson is a library for parsing json into queue of tokens
+ *
+ * Copyright (C) 2014  Nikolay Orliuk <virkony@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pjson_utf8_h__
+#define __pjson_utf8_h__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "pjson.h"
+#include "pjson_simd.h"
+#include "pjson_debug.h"
+
+/* Validation of UTF-8 in string bodies (see PJ_OPT_UTF8). Plain ASCII is
+ * skipped the same way as without validation, runs of multibyte chars are
+ * checked by 32/16 bytes blocks with lookup tables from "Validating UTF-8
+ * In Less Than One Instruction Per Byte" (Keiser, Lemire) when target has
+ * AVX2/SSSE3 and char by char otherwise. Char cut by the end of chunk is
+ * kept in parser->str till next one.
+ */
+
+/* longest UTF-8 sequence */
+#define PJ_UTF8_MAX 4
+
+/* length of valid UTF-8 char at s with n bytes available, 0 if it's invalid
+ * and -1 if it's cut by the end
+ */
+static int pj_utf8_seq(const uint8_t *s, size_t n)
+{
+    uint8_t lo = 0x80, hi = 0xbf; /* range of second byte */
+    int len, i;
+    switch (s[0])
+    {
+    case 0xc2 ... 0xdf: len = 2; break;
+    case 0xe0: len = 3; lo = 0xa0; break; /* overlong */
+    case 0xe1 ... 0xec: case 0xee: case 0xef: len = 3; break;
+    case 0xed: len = 3; hi = 0x9f; break; /* surrogates */
+    case 0xf0: len = 4; lo = 0x90; break; /* overlong */
+    case 0xf1 ... 0xf3: len = 4; break;
+    case 0xf4: len = 4; hi = 0x8f; break; /* above U+10FFFF */
+    default: return 0;
+    }
+    for (i = 1; i < len; ++i, lo = 0x80, hi = 0xbf)
+    {
+        if ((size_t)i == n) return -1;
+        if (s[i] < lo || s[i] > hi) return 0;
+    }
+    return len;
+}
+
+/* bytes of char cut by the end of block that starts at char boundary */
+static size_t pj_utf8_cut(const uint8_t *end)
+{
+    if (end[-1] >= 0xc0) return 1;
+    if (end[-2] >= 0xe0) return 2;
+    if (end[-3] >= 0xf0) return 3;
+    return 0;
+}
+
+#if defined(PJ_SIMD_AVX2) || defined(PJ_SIMD_SSSE3)
+/* error bits looked up by high and low nibbles of previous byte and high
+ * nibble of current one; their intersection is non-zero for invalid pair
+ */
+#define PJ_U8_TOO_SHORT 0x01 /* lead byte not followed by continuation */
+#define PJ_U8_TOO_LONG 0x02 /* continuation after ASCII */
+#define PJ_U8_OVERLONG_3 0x04
+#define PJ_U8_TOO_LARGE 0x08
+#define PJ_U8_SURROGATE 0x10
+#define PJ_U8_OVERLONG_2 0x20
+#define PJ_U8_TOO_LARGE_1000 0x40
+#define PJ_U8_OVERLONG_4 0x40
+#define PJ_U8_TWO_CONTS 0x80 /* continuation after continuation (may be fine) */
+#define PJ_U8_CARRY (PJ_U8_TOO_SHORT | PJ_U8_TOO_LONG | PJ_U8_TWO_CONTS)
+
+static const uint8_t pj_utf8_byte1_high[16] = {
+    /* ASCII */
+    PJ_U8_TOO_LONG, PJ_U8_TOO_LONG, PJ_U8_TOO_LONG, PJ_U8_TOO_LONG,
+    PJ_U8_TOO_LONG, PJ_U8_TOO_LONG, PJ_U8_TOO_LONG, PJ_U8_TOO_LONG,
+    /* continuation */
+    PJ_U8_TWO_CONTS, PJ_U8_TWO_CONTS, PJ_U8_TWO_CONTS, PJ_U8_TWO_CONTS,
+    /* 110_ lead */
+    PJ_U8_TOO_SHORT | PJ_U8_OVERLONG_2,
+    PJ_U8_TOO_SHORT,
+    /* 1110 lead */
+    PJ_U8_TOO_SHORT | PJ_U8_OVERLONG_3 | PJ_U8_SURROGATE,
+    /* 1111 lead */
+    PJ_U8_TOO_SHORT | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000 | PJ_U8_OVERLONG_4,
+};
+
+static const uint8_t pj_utf8_byte1_low[16] = {
+    PJ_U8_CARRY | PJ_U8_OVERLONG_3 | PJ_U8_OVERLONG_2 | PJ_U8_OVERLONG_4,
+    PJ_U8_CARRY | PJ_U8_OVERLONG_2,
+    PJ_U8_CARRY,
+    PJ_U8_CARRY,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000 | PJ_U8_SURROGATE,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+    PJ_U8_CARRY | PJ_U8_TOO_LARGE | PJ_U8_TOO_LARGE_1000,
+};
+
+static const uint8_t pj_utf8_byte2_high[16] = {
+    /* ASCII */
+    PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT,
+    PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT,
+    /* 1000 continuation */
+    PJ_U8_TOO_LONG | PJ_U8_OVERLONG_2 | PJ_U8_TWO_CONTS | PJ_U8_OVERLONG_3 | PJ_U8_TOO_LARGE_1000 | PJ_U8_OVERLONG_4,
+    /* 1001 continuation */
+    PJ_U8_TOO_LONG | PJ_U8_OVERLONG_2 | PJ_U8_TWO_CONTS | PJ_U8_OVERLONG_3 | PJ_U8_TOO_LARGE,
+    /* 101_ continuation */
+    PJ_U8_TOO_LONG | PJ_U8_OVERLONG_2 | PJ_U8_TWO_CONTS | PJ_U8_SURROGATE | PJ_U8_TOO_LARGE,
+    PJ_U8_TOO_LONG | PJ_U8_OVERLONG_2 | PJ_U8_TWO_CONTS | PJ_U8_SURROGATE | PJ_U8_TOO_LARGE,
+    /* lead */
+    PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT, PJ_U8_TOO_SHORT,
+};
+#endif
+
+#ifdef PJ_SIMD_AVX2
+/* mask of '"', '\\', control chars and non-ASCII bytes */
+static unsigned pj_str_ascii_mask32(const char *p)
+{
+    const __m256i x = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i quote = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('"'));
+    const __m256i bslash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'));
+    const __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(0x1f)), x);
+    return _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(quote, bslash), _mm256_or_si256(ctrl, x)));
+}
+
+static __m256i pj_utf8_lookup32(const uint8_t *table, __m256i nibbles)
+{
+    const __m256i t = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+    return _mm256_shuffle_epi8(t, nibbles);
+}
+
+/* is there invalid UTF-8 in block that starts at char boundary? (char cut
+ * by the end of block isn't)
+ */
+static bool pj_utf8_error32(__m256i x)
+{
+    const __m256i lo4 = _mm256_set1_epi8(0x0f);
+    /* x shifted by 16 bytes, so bytes before block are zeroes (ASCII) */
+    const __m256i shifted = _mm256_permute2x128_si256(x, x, 0x08);
+    const __m256i prev1 = _mm256_alignr_epi8(x, shifted, 15);
+    const __m256i prev2 = _mm256_alignr_epi8(x, shifted, 14);
+    const __m256i prev3 = _mm256_alignr_epi8(x, shifted, 13);
+
+    const __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            pj_utf8_lookup32(pj_utf8_byte1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lo4)),
+            pj_utf8_lookup32(pj_utf8_byte1_low, _mm256_and_si256(prev1, lo4))),
+        pj_utf8_lookup32(pj_utf8_byte2_high, _mm256_and_si256(_mm256_srli_epi16(x, 4), lo4)));
+
+    /* third and fourth bytes of char must be continuations */
+    const __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+                                           _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80)));
+    const __m256i err = _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), special);
+    return !_mm256_testz_si256(err, err);
+}
+
+/* check run of multibyte chars at p (char boundary) by blocks that don't
+ * contain string stops
+ * returns where block by block check stops (at char boundary)
+ */
+static const char *pj_utf8_blocks(const char *p, const char * const p_end)
+{
+    while (p_end - p >= 32)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        const unsigned mask = pj_str_ascii_mask32(p);
+        if (mask == 0) break; /* back to ASCII */
+        if ((unsigned)_mm256_movemask_epi8(x) != mask) break; /* end of string or escape */
+        if (pj_utf8_error32(x)) break; /* found char by char */
+        p += 32 - pj_utf8_cut((const uint8_t *)p + 32);
+    }
+    return p;
+}
+#elif defined(PJ_SIMD_SSSE3)
+static __m128i pj_utf8_lookup16(const uint8_t *table, __m128i nibbles)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)table), nibbles);
+}
+
+static bool pj_utf8_error16(__m128i x)
+{
+    const __m128i lo4 = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i prev1 = _mm_alignr_epi8(x, zero, 15);
+    const __m128i prev2 = _mm_alignr_epi8(x, zero, 14);
+    const __m128i prev3 = _mm_alignr_epi8(x, zero, 13);
+
+    const __m128i special = _mm_and_si128(
+        _mm_and_si128(
+            pj_utf8_lookup16(pj_utf8_byte1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), lo4)),
+            pj_utf8_lookup16(pj_utf8_byte1_low, _mm_and_si128(prev1, lo4))),
+        pj_utf8_lookup16(pj_utf8_byte2_high, _mm_and_si128(_mm_srli_epi16(x, 4), lo4)));
+
+    const __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                                        _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80)));
+    const __m128i err = _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char)0x80)), special);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xffff;
+}
+#endif
+
+#ifdef PJ_SIMD_SSE2
+static unsigned pj_str_ascii_mask16(const char *p)
+{
+    const __m128i x = _mm_loadu_si128((const __m128i *)p);
+    const __m128i quote = _mm_cmpeq_epi8(x, _mm_set1_epi8('"'));
+    const __m128i bslash = _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'));
+    const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(0x1f)), x);
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, bslash), _mm_or_si128(ctrl, x)));
+}
+#endif
+
+#if defined(PJ_SIMD_SSSE3) && !defined(PJ_SIMD_AVX2)
+static const char *pj_utf8_blocks(const char *p, const char * const p_end)
+{
+    while (p_end - p >= 16)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *)p);
+        const unsigned mask = pj_str_ascii_mask16(p);
+        if (mask == 0) break;
+        if ((unsigned)_mm_movemask_epi8(x) != mask) break;
+        if (pj_utf8_error16(x)) break;
+        p += 16 - pj_utf8_cut((const uint8_t *)p + 16);
+    }
+    return p;
+}
+#endif
+
+/* same as pj_scan_str() but stops at non-ASCII bytes too */
+static const char *pj_scan_str_ascii(const char *p, const char * const p_end, const char * const p_pad)
+{
+#ifdef PJ_SIMD_AVX2
+    for (; p_end - p >= 32; p += 32)
+    {
+        const unsigned mask = pj_str_ascii_mask32(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 32) return pj_block_stop(p, p_end, pj_str_ascii_mask32(p));
+#endif
+#ifdef PJ_SIMD_SSE2
+    for (; p_end - p >= 16; p += 16)
+    {
+        const unsigned mask = pj_str_ascii_mask16(p);
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    if (p_pad - p >= 16) return pj_block_stop(p, p_end, pj_str_ascii_mask16(p));
+#endif
+    (void) p_pad; /* scalar code goes byte by byte */
+    for (; p != p_end; ++p)
+    {
+        const unsigned char c = *p;
+        if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80) break;
+    }
+    return p;
+}
+
+/* skip plain part of string body checking UTF-8 on the way
+ * returns pointer to the first '"', '\\', control char, p_end or first byte
+ * of char that is invalid or cut by the end
+ */
+static const char *pj_scan_str_utf8(const char *p, const char * const p_end, const char * const p_pad)
+{
+    for (;;)
+    {
+        p = pj_scan_str_ascii(p, p_end, p_pad);
+        if (p == p_end || (uint8_t)*p < 0x80) return p;
+#if defined(PJ_SIMD_AVX2) || defined(PJ_SIMD_SSSE3)
+        p = pj_utf8_blocks(p, p_end);
+        if (p == p_end) return p;
+#endif
+        while ((uint8_t)*p >= 0x80)
+        {
+            const uint8_t * const u = (const uint8_t *)p;
+            int n;
+            /* most of chars don't need range checks of pj_utf8_seq() */
+            if (p_end - p >= 3 && (u[0] & 0xe0) == 0xc0 && u[0] >= 0xc2 && (u[1] & 0xc0) == 0x80)
+                n = 2;
+            else if (p_end - p >= 3 && (u[0] & 0xf0) == 0xe0 && u[0] != 0xe0 && u[0] != 0xed &&
+                     ((u[1] | u[2] << 8) & 0xc0c0) == 0x8080)
+                n = 3;
+            else if ((n = pj_utf8_seq(u, p_end - p)) <= 0)
+                return p;
+            p += n;
+            if (p == p_end) return p;
+        }
+    }
+}
+
+/* complete char cut by the end of previous chunk with bytes at *p
+ * returns false if it is invalid
+ */
+static bool pj_utf8_resume(pj_parser_ref parser, const char **p)
+{
+    const size_t tail_len = parser->str.tail_len;
+    const size_t avail = parser->chunk_end - *p;
+    const size_t n = avail < PJ_UTF8_MAX - tail_len ? avail : PJ_UTF8_MAX - tail_len;
+    uint8_t s[PJ_UTF8_MAX];
+
+    (void) memcpy(s, parser->str.tail, tail_len);
+    (void) memcpy(s + tail_len, *p, n);
+    const int len = pj_utf8_seq(s, tail_len + n);
+    TRACEF("resumed UTF-8 char of %zd bytes: %d", tail_len, len);
+    if (len == 0) return false;
+    if (len < 0)
+    {
+        /* still cut */
+        (void) memcpy(parser->str.tail, s, tail_len + n);
+        parser->str.tail_len = tail_len + n;
+        *p += n;
+        return true;
+    }
+    parser->str.tail_len = 0;
+    *p += len - tail_len;
+    return true;
+}
+
+/* same as pj_scan_str() for PJ_OPT_UTF8; char cut by the end of chunk is
+ * kept in parser->str
+ */
+static const char *pj_next_str_stop_utf8(pj_parser_ref parser, const char *p)
+{
+    const char * const p_end = parser->chunk_end;
+    p = pj_scan_str_utf8(p, p_end, parser->chunk_pad);
+    if (p == p_end || (uint8_t)*p < 0x80 || pj_utf8_seq((const uint8_t *)p, p_end - p) == 0) return p;
+
+    parser->str.tail_len = p_end - p;
+    (void) memcpy(parser->str.tail, p, p_end - p);
+    return p_end;
+}
+
+#endif
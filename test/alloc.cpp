@@ -0,0 +1,134 @@
+#include <array>
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    struct counter {
+        size_t live = 0, total = 0;
+        bool fail = false;
+    };
+
+    void *counting_alloc(void *ctx, size_t len)
+    {
+        counter &c = *static_cast<counter *>(ctx);
+        if (c.fail) return nullptr;
+        ++c.live;
+        ++c.total;
+        return malloc(len);
+    }
+
+    void counting_free(void *ctx, void *block)
+    {
+        --static_cast<counter *>(ctx)->live;
+        free(block);
+    }
+
+    /* dump of all strings with sample split at n */
+    string parse(const string &sample, size_t n, counter &c, int options = 0)
+    {
+        const pj_allocator alloc = { counting_alloc, counting_free, &c };
+        pj_parser parser;
+        pj_init_alloc(&parser, &alloc);
+        pj_set_options(&parser, options);
+
+        string dump;
+        pj_feed_chunks(&parser, pj_chunks_split(sample, n), [&]() -> bool {
+            for (;;)
+            {
+                array<pj_token, 4> tokens;
+                pj_token terminal;
+                const size_t count = pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal);
+                /* all tokens of batch are still valid */
+                for (size_t k = 0; k < count; ++k)
+                {
+                    if (tokens[k].token_type == PJ_TOK_STR ||
+                        (tokens[k].token_type == PJ_TOK_KEY && (options & PJ_OPT_FUSED_KEY)))
+                        dump += string(tokens[k].str, tokens[k].len) + " ";
+                }
+                if (count == tokens.size()) continue;
+                if (terminal.token_type == PJ_STARVING) return true;
+                if (terminal.token_type != PJ_END) dump += to_string(terminal.token_type);
+                return false;
+            }
+        });
+        pj_done(&parser);
+        return dump;
+    }
+}
+
+TEST(alloc, grows)
+{
+    const string a(300, 'a'), b(1000, 'b'), c(5000, 'c');
+    const string sample = "[\"" + a + "\\n\", \"x\\ty\", \"" + b + "\\\"\", {\"" + c + "\\/\": 1}]";
+    const string expected = a + "\n x\ty " + b + "\" " + c + "/ ";
+
+    for (size_t n = 0; n <= sample.size(); n += 7)
+    {
+        counter cnt;
+        ASSERT_EQ( expected, parse(sample, n, cnt) ) << "split at " << n;
+        EXPECT_EQ( 0, cnt.live ) << "split at " << n;
+        EXPECT_LT( 0, cnt.total );
+
+        cnt = counter();
+        ASSERT_EQ( expected, parse(sample, n, cnt, PJ_OPT_FUSED_KEY) ) << "split at " << n;
+        EXPECT_EQ( 0, cnt.live ) << "split at " << n;
+    }
+}
+
+TEST(alloc, no_buffer_needed)
+{
+    counter cnt;
+    EXPECT_EQ( "abc def ", parse("[\"abc\", \"def\"]", 0, cnt) );
+    EXPECT_EQ( 0, cnt.total );
+}
+
+TEST(alloc, failure)
+{
+    counter cnt;
+    const pj_allocator alloc = { counting_alloc, counting_free, &cnt };
+    pj_parser parser;
+    pj_init_alloc(&parser, &alloc);
+
+    cnt.fail = true;
+    pj_feed(&parser, "[\"a\\nb\"]");
+    array<pj_token, 4> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+    ASSERT_EQ( PJ_OVERFLOW, tokens[1].token_type );
+
+    /* retry */
+    cnt.fail = false;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_STR, tokens[0].token_type );
+    EXPECT_EQ( "a\nb", string(tokens[0].str, tokens[0].len) );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[1].token_type );
+
+    pj_done(&parser);
+    EXPECT_EQ( 0, cnt.live );
+}
+
+TEST(alloc, compact)
+{
+    counter cnt;
+    const pj_allocator alloc = { counting_alloc, counting_free, &cnt };
+    pj_parser parser;
+    pj_init_alloc(&parser, &alloc);
+
+    /* offsets of strings formed before growth stay valid */
+    const string a(100, 'a'), b(2000, 'b');
+    const string sample = "[\"" + a + "\\t\", \"" + b + "\\t\"]";
+    pj_feed(&parser, sample);
+    array<pj_ctoken, 4> tokens;
+    ASSERT_EQ( 4, pj_poll_compact(&parser, tokens.data(), tokens.size()) );
+    EXPECT_EQ( a + "\t", string(PJ_CTOK_STR(&parser, &tokens[1]), PJ_CTOK_LEN(&tokens[1])) );
+    EXPECT_EQ( b + "\t", string(PJ_CTOK_STR(&parser, &tokens[2]), PJ_CTOK_LEN(&tokens[2])) );
+    EXPECT_LT( 1, cnt.total );
+
+    pj_done(&parser);
+    EXPECT_EQ( 0, cnt.live );
+}
@@ -0,0 +1,173 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    string dump_token(int type, const char *str, size_t len, int options)
+    {
+        switch (type)
+        {
+        case PJ_TOK_KEY:
+            if (!(options & PJ_OPT_FUSED_KEY)) return to_string(type) + " ";
+            /* fall through */
+        case PJ_TOK_STR:
+        case PJ_TOK_NUM:
+            return to_string(type) + "(" + string(str, len) + ") ";
+        default:
+            return to_string(type) + " ";
+        }
+    }
+
+    enum mode { full, compact, soa };
+
+    /* dump of tokens with sample split at n and buffer growing on overflow */
+    string parse(const string &sample, size_t n, bool compact, int options = 0)
+    {
+        pj_parser parser;
+        vector<char> buf(4);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options);
+
+        string dump;
+        pj_feed_chunks(&parser, pj_chunks_split(sample, n), [&]() -> bool {
+            for (;;)
+            {
+                size_t required = 0;
+                if (compact)
+                {
+                    array<pj_ctoken, 3> tokens;
+                    pj_poll_compact(&parser, tokens.data(), tokens.size());
+                    for (auto &token : tokens)
+                    {
+                        const int type = PJ_CTOK_TYPE(&token);
+                        if (type == PJ_STARVING) return true;
+                        else if (type == PJ_OVERFLOW) required = token.offset;
+                        else if (type == PJ_END) return false;
+                        else if (type == PJ_ERR) { dump += "!"; return false; }
+                        else dump += dump_token(type, PJ_CTOK_STR(&parser, &token), PJ_CTOK_LEN(&token), options);
+                        if (type < PJ_TOK_NULL) break;
+                    }
+                }
+                else
+                {
+                    array<pj_token, 3> tokens;
+                    pj_poll(&parser, tokens.data(), tokens.size());
+                    for (auto &token : tokens)
+                    {
+                        const int type = token.token_type;
+                        if (type == PJ_STARVING) return true;
+                        else if (type == PJ_OVERFLOW) required = token.len;
+                        else if (type == PJ_END) return false;
+                        else if (type == PJ_ERR) { dump += "!"; return false; }
+                        else dump += dump_token(type, token.str, token.len, options);
+                        if (type < PJ_TOK_NULL) break;
+                    }
+                }
+                if (required > 0)
+                {
+                    vector<char> bigger(required);
+                    pj_realloc(&parser, bigger.data(), bigger.size());
+                    buf.swap(bigger);
+                }
+            }
+        });
+        return dump;
+    }
+}
+
+TEST(compact, size)
+{
+    EXPECT_EQ( 8, sizeof(pj_ctoken) );
+}
+
+TEST(compact, same_as_poll)
+{
+    const string sample =
+        "{\"id\": 12345, \"name\": \"long enough n\\u0061me\", \"tags\": [\"a\", \"\\\"b\\\"\", null],"
+        " \"ok\": true, \"no\": false, \"pi\": -3.14159e+0}";
+
+    for (int options : { 0, (int)PJ_OPT_FUSED_KEY })
+    {
+        for (size_t n = 0; n <= sample.size(); ++n)
+        {
+            const string expected = parse(sample, n, full, options);
+            ASSERT_EQ( expected, parse(sample, n, compact, options) ) << "split at " << n;
+            ASSERT_EQ( expected, parse(sample, n, soa, options) ) << "split at " << n;
+        }
+    }
+    const string head = "9 7(id) 10 8(12345) 7(name) 10 7(long enough name) ";
+    EXPECT_EQ( head, parse(sample, 0, compact).substr(0, head.size()) );
+}
+
+TEST(compact, number_at_end)
+{
+    EXPECT_EQ( "8(12345) ", parse("12345", 3, compact) );
+    EXPECT_EQ( "8(12345) ", parse("12345", 3, soa) );
+}
+
+TEST(compact, long_token)
+{
+    const string sample = "[\"" + string(PJ_CTOK_LEN_MAX + 1, 'x') + "\", 1]";
+
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_feed(&parser, sample);
+
+    array<pj_ctoken, 4> tokens;
+    pj_poll_compact(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_TOK_ARR, PJ_CTOK_TYPE(&tokens[0]) );
+    EXPECT_EQ( PJ_CTOK_LONG, PJ_CTOK_TYPE(&tokens[1]) );
+
+    /* repeated until taken */
+    pj_poll_compact(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_CTOK_LONG, PJ_CTOK_TYPE(&tokens[0]) );
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( PJ_CTOK_LEN_MAX + 1, token.len );
+    EXPECT_EQ( sample.data() + 2, token.str );
+
+    pj_poll_compact(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_TOK_NUM, PJ_CTOK_TYPE(&tokens[0]) );
+    EXPECT_EQ( "1", string(PJ_CTOK_STR(&parser, &tokens[0]), PJ_CTOK_LEN(&tokens[0])) );
+    EXPECT_EQ( PJ_TOK_ARR_E, PJ_CTOK_TYPE(&tokens[1]) );
+    EXPECT_EQ( PJ_STARVING, PJ_CTOK_TYPE(&tokens[2]) );
+}
+
+TEST(compact, soa_types)
+{
+    pj_parser parser;
+    char buf[256];
+    pj_init(&parser, buf, sizeof(buf));
+
+    const string sample = "[{\"a\": 1}, {\"b\": [2, 3]}, {}, \"x\\ty\"]";
+    pj_feed(&parser, sample);
+
+    uint8_t types[32];
+    uint32_t offsets[32], lens[32];
+    pj_poll_soa(&parser, types, offsets, lens, 32);
+
+    size_t maps = 0, nums = 0, i;
+    for (i = 0; types[i] != PJ_STARVING; ++i)
+    {
+        maps += types[i] == PJ_TOK_MAP;
+        nums += types[i] == PJ_TOK_NUM;
+    }
+    EXPECT_EQ( 3, maps );
+    EXPECT_EQ( 3, nums );
+    EXPECT_EQ( 18, i );
+
+    /* escaped string is formed in buffer */
+    ASSERT_EQ( PJ_TOK_STR, types[16] );
+    EXPECT_TRUE( lens[16] & PJ_SOA_BUF );
+    EXPECT_EQ( "x\ty", string(PJ_SOA_STR(&parser, offsets, lens, 16), PJ_SOA_LEN(lens, 16)) );
+    ASSERT_EQ( PJ_TOK_NUM, types[4] );
+    EXPECT_FALSE( lens[4] & PJ_SOA_BUF );
+    EXPECT_EQ( sample.data() + 7, PJ_SOA_STR(&parser, offsets, lens, 4) );
+}
@@ -0,0 +1,154 @@
+#include <array>
+#include <list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of tokens with sample fed by chunks of n bytes; strings that
+     * point into sample are marked with '@'
+     */
+    string parse(const string &sample, size_t n, int options, size_t buf_len = 0)
+    {
+        pj_parser parser;
+        vector<char> buf(buf_len);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options);
+
+        return pj_dump_chunks(&parser, pj_chunks_by(sample, n), [&](string &dump, const pj_token &token) {
+            switch (token.token_type)
+            {
+            case PJ_TOK_KEY:
+                if (!(options & PJ_OPT_FUSED_KEY)) { dump += ": "; break; }
+                /* fall through */
+            case PJ_TOK_STR:
+            case PJ_TOK_NUM:
+                dump += (pj_in_sample(sample, token) ? "@" : "") + string(token.str, token.len) + " ";
+                break;
+            default: dump += to_string(token.token_type) + " ";
+            }
+        });
+    }
+}
+
+TEST(contiguous, no_buffer)
+{
+    const string sample = "{\"name\": \"long enough name\", \"tags\": [\"a\", \"b\"], \"pi\": -3.14159e+0, \"n\": 12345}";
+    const string expected =
+        "9 @name : @long enough name @tags : 12 @a @b 13 @pi : @-3.14159e+0 @n : @12345 11 ";
+    const string fused = "9 @name @long enough name @tags 12 @a @b 13 @pi @-3.14159e+0 @n @12345 11 ";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+    {
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_CONTIGUOUS) ) << "chunks of " << n;
+        ASSERT_EQ( fused, parse(sample, n, PJ_OPT_CONTIGUOUS | PJ_OPT_FUSED_KEY) ) << "chunks of " << n;
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_CONTIGUOUS | PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE) )
+            << "chunks of " << n;
+    }
+
+    /* number till the end of input */
+    EXPECT_EQ( "@12345 ", parse("12345", 2, PJ_OPT_CONTIGUOUS) );
+}
+
+TEST(contiguous, escapes)
+{
+    const string sample = "[\"plain\", \"x\\\"y\\u0041\\\\\", \"\\n\", \"tail\\t\"]";
+    const string expected = "12 @plain x\"yA\\ \n tail\t 13 ";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_CONTIGUOUS, 16) ) << "chunks of " << n;
+
+    /* buffer holds only decoded strings */
+    EXPECT_EQ( "12 @plain overflow", parse(sample, 1, PJ_OPT_CONTIGUOUS, 4) );
+    EXPECT_EQ( "12 overflow", parse(sample, 1, 0, 4) );
+}
+
+TEST(contiguous, escape_cut_overflow)
+{
+    /* chunk ends right after backslash and slice doesn't fit into buffer */
+    const string sample = "\"\\n\\\"abcdef\"";
+    pj_parser parser;
+    pj_init(&parser, nullptr, 0);
+    pj_set_options(&parser, PJ_OPT_CONTIGUOUS);
+
+    list<vector<char>> bufs;
+    pj_token token;
+    size_t overflows = 0;
+    for (size_t offset : { (size_t)0, (size_t)4 })
+    {
+        pj_feed(&parser, sample.data() + offset, offset == 0 ? 4 : sample.size() - 4);
+        for (;;)
+        {
+            pj_poll(&parser, &token, 1);
+            if (token.token_type != PJ_OVERFLOW) break;
+            ++overflows;
+            bufs.emplace_back(token.len);
+            pj_realloc(&parser, bufs.back().data(), bufs.back().size());
+        }
+    }
+    EXPECT_LT( 0, overflows );
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( "\n\"abcdef", string(token.str, token.len) );
+}
+
+TEST(contiguous, gap)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_CONTIGUOUS);
+
+    /* chunks without incomplete token don't have to be contiguous */
+    const string first = "[1, ", second = "2, 34]";
+    pj_feed(&parser, first);
+    array<pj_token, 4> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_STARVING, tokens[2].token_type );
+
+    pj_feed(&parser, second.data(), 3);
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+    ASSERT_EQ( PJ_STARVING, tokens[1].token_type );
+
+    /* but continuation of "3" does */
+    pj_feed(&parser, second.data() + 3, 1);
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_STARVING, tokens[0].token_type );
+    pj_feed(&parser, second.data() + 4, 2);
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+    EXPECT_EQ( second.data() + 3, tokens[0].str );
+    EXPECT_EQ( "34", string(tokens[0].str, tokens[0].len) );
+}
+
+TEST(contiguous, compact)
+{
+    const string sample = "[\"abc\", 12345]";
+
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_CONTIGUOUS);
+    pj_feed(&parser, sample.data(), 4);
+
+    array<pj_ctoken, 4> ctokens;
+    ASSERT_EQ( 1, pj_poll_compact(&parser, ctokens.data(), ctokens.size()) );
+    EXPECT_EQ( PJ_STARVING, PJ_CTOK_TYPE(&ctokens[1]) );
+
+    /* string from previous chunk can't be addressed by offset */
+    pj_feed(&parser, sample.data() + 4, sample.size() - 4);
+    ASSERT_EQ( 0, pj_poll_compact(&parser, ctokens.data(), ctokens.size()) );
+    EXPECT_EQ( PJ_CTOK_LONG, PJ_CTOK_TYPE(&ctokens[0]) );
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( sample.data() + 2, token.str );
+    EXPECT_EQ( 3, token.len );
+
+    ASSERT_EQ( 2, pj_poll_compact(&parser, ctokens.data(), ctokens.size()) );
+    EXPECT_EQ( PJ_TOK_NUM, PJ_CTOK_TYPE(&ctokens[0]) );
+    EXPECT_FALSE( ctokens[0].info & PJ_CTOK_BUF );
+}
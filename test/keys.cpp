@@ -0,0 +1,187 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    const char * const names[] = { "id", "name", "tags", "created_at", "updated_at" };
+
+    /* "key=id" for each string and "id:" for each PJ_TOK_KEY with sample split at n */
+    string parse(const string &sample, size_t n)
+    {
+        pj_parser parser;
+        pj_keys keys;
+        char buf[256];
+        pj_init(&parser, buf, sizeof(buf));
+        EXPECT_EQ( 0, pj_set_keys(&parser, &keys, names, sizeof(names) / sizeof(names[0])) );
+
+        return pj_dump_chunks(&parser, pj_chunks_split(sample, n), [](string &dump, const pj_token &token) {
+            switch (token.token_type)
+            {
+            case PJ_TOK_STR:
+                dump += string(token.str, token.len);
+                if (token.flags & PJ_STR_KEY) dump += "=" + to_string(token.val.key);
+                dump += " ";
+                break;
+            case PJ_TOK_KEY:
+                dump += to_string(token.val.key) + ": ";
+                break;
+            default: ;
+            }
+        });
+    }
+}
+
+TEST(keys, ids)
+{
+    const string sample =
+        "{\"id\": \"name\", \"tags\": [\"id\", {\"updated_at\": 1, \"other\": 2}],"
+        " \"na\\u006de\": null, \"created_at\": {}, \"nam\": \"x\", \"ids\": 0}";
+    const string expected =
+        "id=0 0: name tags=2 2: id updated_at=4 4: other=-1 -1: "
+        "name=1 1: created_at=3 3: nam=-1 -1: x ids=-1 -1: ";
+
+    for (size_t n = 0; n <= sample.size(); ++n)
+        ASSERT_EQ( expected, parse(sample, n) ) << "split at " << n;
+}
+
+TEST(keys, many)
+{
+    vector<string> storage;
+    vector<const char *> many;
+    for (size_t i = 0; i <= PJ_KEYS_MAX; ++i) storage.push_back("field_" + to_string(i));
+    for (auto &s : storage) many.push_back(s.c_str());
+
+    pj_parser parser;
+    pj_keys keys;
+    pj_init(&parser, 0, 0);
+
+    EXPECT_EQ( -1, pj_set_keys(&parser, &keys, many.data(), many.size()) );
+    ASSERT_EQ( 0, pj_set_keys(&parser, &keys, many.data(), PJ_KEYS_MAX) );
+
+    string sample = "{";
+    for (size_t i = 0; i <= PJ_KEYS_MAX; ++i) sample += "\"" + storage[PJ_KEYS_MAX - i] + "\":0,";
+    sample.back() = '}';
+    pj_feed(&parser, sample);
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_MAP, token.token_type );
+    for (size_t i = 0; i <= PJ_KEYS_MAX; ++i)
+    {
+        array<pj_token, 3> tokens;
+        pj_poll(&parser, tokens.data(), tokens.size());
+        ASSERT_EQ( PJ_TOK_STR, tokens[0].token_type ) << i;
+        ASSERT_EQ( PJ_TOK_KEY, tokens[1].token_type ) << i;
+        const int expected = i == 0 ? -1 : (int)(PJ_KEYS_MAX - i);
+        EXPECT_EQ( expected, tokens[0].val.key ) << i;
+        EXPECT_EQ( expected, tokens[1].val.key ) << i;
+    }
+}
+
+TEST(keys, errors)
+{
+    pj_parser parser;
+    pj_keys keys;
+    pj_init(&parser, 0, 0);
+
+    const char * const duplicates[] = { "a", "b", "a" };
+    EXPECT_EQ( -1, pj_set_keys(&parser, &keys, duplicates, 3) );
+    EXPECT_EQ( 0, pj_set_keys(&parser, &keys, duplicates, 2) );
+    EXPECT_EQ( 0, pj_set_keys(&parser, &keys, NULL, 0) );
+    EXPECT_EQ( 0, pj_set_keys(&parser, NULL, NULL, 0) );
+
+    /* strings are not marked without dictionary */
+    pj_feed(&parser, "{\"a\":0}");
+    array<pj_token, 4> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_STR, tokens[1].token_type );
+    EXPECT_EQ( 0, tokens[1].flags );
+}
+
+namespace {
+    /* dump of fused tokens with sample split at n, buffer grows on overflow */
+    string parse_fused(const string &sample, size_t n, bool dictionary, size_t *overflows = nullptr)
+    {
+        pj_parser parser;
+        pj_keys keys;
+        vector<char> buf;
+        pj_init(&parser, 0, 0);
+        pj_set_options(&parser, PJ_OPT_FUSED_KEY);
+        if (dictionary) pj_set_keys(&parser, &keys, names, sizeof(names) / sizeof(names[0]));
+
+        string dump;
+        pj_feed_chunks(&parser, pj_chunks_split(sample, n), [&]() -> bool {
+            for (;;)
+            {
+                array<pj_token, 2> tokens;
+                pj_poll(&parser, tokens.data(), tokens.size());
+                for (auto &token : tokens)
+                {
+                    switch (token.token_type)
+                    {
+                    case PJ_STARVING: return true;
+                    case PJ_END: return false;
+                    case PJ_ERR: dump += "!"; return false;
+                    case PJ_OVERFLOW:
+                    {
+                        if (overflows != nullptr) ++*overflows;
+                        vector<char> bigger(token.len);
+                        pj_realloc(&parser, bigger.data(), bigger.size());
+                        buf.swap(bigger);
+                        break;
+                    }
+                    case PJ_TOK_STR: dump += string(token.str, token.len) + " "; continue;
+                    case PJ_TOK_KEY:
+                        dump += string(token.str, token.len);
+                        if (dictionary) dump += "=" + to_string(token.val.key);
+                        dump += ": ";
+                        continue;
+                    default: dump += to_string(token.token_type) + " "; continue;
+                    }
+                    break;
+                }
+            }
+        });
+        return dump;
+    }
+}
+
+TEST(keys, fused)
+{
+    const string sample =
+        "{\"id\": \"name\", \"ta\\\"gs\" /* c */ : [\"id\", {\"\": 1, \"updated_at\"\n// :\n: 2}]}";
+    const string expected = "9 id: name ta\"gs: 12 id 9 : 8 updated_at: 8 11 13 11 ";
+    const string expected_ids = "9 id=0: name ta\"gs=-1: 12 id 9 =-1: 8 updated_at=4: 8 11 13 11 ";
+
+    for (size_t n = 0; n <= sample.size(); ++n)
+    {
+        ASSERT_EQ( expected, parse_fused(sample, n, false) ) << "split at " << n;
+        ASSERT_EQ( expected_ids, parse_fused(sample, n, true) ) << "split at " << n;
+    }
+}
+
+TEST(keys, fused_overflow)
+{
+    /* key that is complete in first chunk is copied to buffer */
+    size_t overflows = 0;
+    EXPECT_EQ( "9 abc: 8 11 ", parse_fused("{\"abc\" : 1}", 6, false, &overflows) );
+    EXPECT_EQ( 1, overflows );
+
+    overflows = 0;
+    EXPECT_EQ( "9 abc: 8 11 ", parse_fused("{\"abc\" : 1}", 7, false, &overflows) );
+    EXPECT_EQ( 1, overflows );
+
+    overflows = 0;
+    EXPECT_EQ( "9 abc: 8 11 ", parse_fused("{\"abc\" : 1}", 8, false, &overflows) );
+    EXPECT_EQ( 0, overflows );
+
+    /* empty key needs no buffer at all */
+    overflows = 0;
+    EXPECT_EQ( "9 : 8 11 ", parse_fused("{\"\" : 1}", 3, false, &overflows) );
+    EXPECT_EQ( 0, overflows );
+}
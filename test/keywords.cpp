@@ -1,4 +1,5 @@
 #include <array>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -129,3 +130,38 @@ TEST(keywords, bool_false)
     pj_poll(&parser, tokens.data(), tokens.size());
     EXPECT_EQ( PJ_END, tokens[0].token_type );
 }
+
+TEST(keywords, chunked)
+{
+    pj_parser parser;
+    const string sample = "[false,true,null]";
+
+    for (size_t n = 1; n < sample.size(); ++n)
+    {
+        pj_init(&parser, 0, 0);
+
+        vector<pj_token_type> types;
+        array<pj_token, 8> tokens;
+
+        pj_feed(&parser, sample.data(), n);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        for (size_t i = 0; tokens[i].token_type != PJ_STARVING; ++i)
+        {
+            ASSERT_NE( PJ_ERR, tokens[i].token_type ) << "split at " << n;
+            types.push_back(tokens[i].token_type);
+        }
+
+        pj_feed(&parser, sample.data() + n, sample.size() - n);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        for (size_t i = 0; tokens[i].token_type != PJ_STARVING; ++i)
+        {
+            ASSERT_NE( PJ_ERR, tokens[i].token_type ) << "split at " << n;
+            types.push_back(tokens[i].token_type);
+        }
+
+        const vector<pj_token_type> expected {
+            PJ_TOK_ARR, PJ_TOK_FALSE, PJ_TOK_TRUE, PJ_TOK_NULL, PJ_TOK_ARR_E
+        };
+        EXPECT_EQ( expected, types ) << "split at " << n;
+    }
+}
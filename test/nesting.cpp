@@ -0,0 +1,165 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* type of token at which parsing of whole sample stops */
+    pj_token_type last_token(const string &sample)
+    {
+        pj_parser parser;
+        char buf[256];
+        pj_init(&parser, buf, sizeof(buf));
+
+        pj_feed(&parser, sample);
+        for (bool end = false;;)
+        {
+            array<pj_token, 4> tokens;
+            pj_poll(&parser, tokens.data(), tokens.size());
+            for (auto &token : tokens)
+            {
+                switch (token.token_type)
+                {
+                case PJ_STARVING:
+                    if (end) return PJ_STARVING;
+                    pj_feed_end(&parser);
+                    end = true;
+                    break;
+                case PJ_END:
+                case PJ_ERR:
+                case PJ_OVERFLOW:
+                    return token.token_type;
+                default:
+                    continue;
+                }
+                break;
+            }
+        }
+    }
+}
+
+TEST(nesting, valid)
+{
+    for (auto sample : {
+            "[]", "{}", "[[]]", "[{}]", "{\"a\":[]}", "{\"a\":{}}",
+            "[1,[2,{\"a\":3}],{\"b\":[4]}]", "{\"a\":1,\"b\":\"2\",\"c\":null}",
+            " { \"a\" : [ 1 , 2 ] , \"b\" : { } } ", "[1],[2]",
+        })
+    {
+        EXPECT_EQ( PJ_END, last_token(sample) ) << sample;
+    }
+}
+
+TEST(nesting, mismatch)
+{
+    for (auto sample : {
+            "[}", "{]", "[[]}", "[{]}", "]", "}", "[]]", "{}}", "{\"a\":[}",
+        })
+    {
+        EXPECT_EQ( PJ_ERR, last_token(sample) ) << sample;
+    }
+}
+
+TEST(nesting, unclosed)
+{
+    for (auto sample : { "[", "{", "[[]", "{\"a\":[1]", "[1", "{\"a\":1" })
+    {
+        EXPECT_EQ( PJ_ERR, last_token(sample) ) << sample;
+    }
+}
+
+TEST(nesting, key_value)
+{
+    for (auto sample : {
+            "{1:2}", "{null:1}", "{\"a\"}", "{\"a\",\"b\"}", "{\"a\":}", "{\"a\":1,}",
+            "{,}", "{\"a\":1\"b\":2}", "{\"a\"::1}", "{\"a\":1:2}", "[\"a\":1]",
+            "\"a\":1", "{\"a\":1,2}",
+        })
+    {
+        EXPECT_EQ( PJ_ERR, last_token(sample) ) << sample;
+    }
+}
+
+TEST(nesting, depth)
+{
+    pj_parser parser;
+    char buf[256];
+    pj_init(&parser, buf, sizeof(buf));
+
+    pj_feed(&parser, "[{\"a\":[1]},2]");
+
+    array<pj_token, 12> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+
+    const struct { pj_token_type type; int depth; } expected[] = {
+        { PJ_TOK_ARR, 0 },
+        { PJ_TOK_MAP, 1 },
+        { PJ_TOK_STR, 2 },
+        { PJ_TOK_KEY, 2 },
+        { PJ_TOK_ARR, 2 },
+        { PJ_TOK_NUM, 3 },
+        { PJ_TOK_ARR_E, 2 },
+        { PJ_TOK_MAP_E, 1 },
+        { PJ_TOK_NUM, 1 },
+        { PJ_TOK_ARR_E, 0 },
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        ASSERT_EQ( expected[i].type, tokens[i].token_type ) << i;
+        EXPECT_EQ( expected[i].depth, tokens[i].depth ) << i;
+    }
+    EXPECT_EQ( PJ_STARVING, tokens[10].token_type );
+}
+
+TEST(nesting, max_depth)
+{
+    const string deepest = string(PJ_MAX_DEPTH, '[') + string(PJ_MAX_DEPTH, ']');
+    EXPECT_EQ( PJ_END, last_token(deepest) );
+
+    const string deeper = string(PJ_MAX_DEPTH + 1, '[') + string(PJ_MAX_DEPTH + 1, ']');
+    EXPECT_EQ( PJ_ERR, last_token(deeper) );
+
+    /* stack words boundaries */
+    string mixed;
+    for (size_t i = 0; i < 200; ++i) mixed += (i % 3) ? "[" : "{\"k\":";
+    for (size_t i = 200; i-- > 0;) mixed += (i % 3) ? "]" : "}";
+    EXPECT_EQ( PJ_END, last_token(mixed) );
+}
+
+TEST(nesting, chunked)
+{
+    const string sample = "{\"a\" : [1, {\"b\": \"c\"}], \"d\": {}}";
+    for (size_t n = 0; n <= sample.size(); ++n)
+    {
+        pj_parser parser;
+        char buf[256];
+        pj_init(&parser, buf, sizeof(buf));
+
+        vector<int> depths;
+        const string chunks[] = { sample.substr(0, n), sample.substr(n) };
+        for (auto &chunk : chunks)
+        {
+            pj_feed(&parser, chunk);
+            for (bool starving = false; !starving;)
+            {
+                array<pj_token, 4> tokens;
+                pj_poll(&parser, tokens.data(), tokens.size());
+                for (auto &token : tokens)
+                {
+                    ASSERT_NE( PJ_ERR, token.token_type ) << n;
+                    if (token.token_type == PJ_STARVING)
+                    {
+                        starving = true;
+                        break;
+                    }
+                    depths.push_back(token.depth);
+                }
+            }
+        }
+        EXPECT_EQ( (vector<int>{ 0, 1, 1, 1, 2, 2, 3, 3, 3, 2, 1, 1, 1, 1, 1, 0 }), depths ) << n;
+    }
+}
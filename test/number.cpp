@@ -1,4 +1,8 @@
 #include <array>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -214,6 +218,33 @@ TEST(number, chunked)
     EXPECT_EQ( "3.141592", string(tokens[0].str, tokens[0].len) );
 }
 
+TEST(number, chunked_overflow)
+{
+    pj_parser parser;
+    char buf[256];
+    pj_init(&parser, buf, 2); /* lie that we have only 2 bytes buffer */
+
+    pj_feed(&parser, "[12345");
+
+    array<pj_token, 3> tokens;
+
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+    EXPECT_EQ( PJ_OVERFLOW, tokens[1].token_type );
+    EXPECT_EQ( 5, tokens[1].len );
+
+    pj_realloc(&parser, buf, sizeof(buf));
+    pj_poll(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_STARVING, tokens[0].token_type );
+
+    pj_feed(&parser, "6]");
+
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+    EXPECT_EQ( "123456", string(tokens[0].str, tokens[0].len) );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[1].token_type );
+}
+
 TEST(number, integer_final)
 {
     pj_parser parser;
@@ -351,3 +382,217 @@ TEST(number, two_final_toks)
     pj_poll(&parser, tokens.data(), tokens.size());
     EXPECT_EQ( PJ_END, tokens[0].token_type );
 }
+
+TEST(number, int_values)
+{
+    const struct { const char *text; int64_t value; int flags; } samples[] = {
+        { "0", 0, PJ_NUM_INT },
+        { "-0", 0, PJ_NUM_INT },
+        { "42", 42, PJ_NUM_INT },
+        { "-5", -5, PJ_NUM_INT },
+        { "9223372036854775807", INT64_MAX, PJ_NUM_INT },
+        { "-9223372036854775808", INT64_MIN, PJ_NUM_INT },
+        { "9223372036854775808", INT64_MAX, PJ_NUM_INT | PJ_NUM_OVERFLOW },
+        { "-9223372036854775809", INT64_MIN, PJ_NUM_INT | PJ_NUM_OVERFLOW },
+        { "18446744073709551616", INT64_MAX, PJ_NUM_INT | PJ_NUM_OVERFLOW },
+        { "3.5", 0, 0 },
+        { "1e3", 0, 0 },
+    };
+
+    for (const auto &sample : samples)
+    {
+        const string text = sample.text;
+        /* any split of text between two chunks */
+        for (size_t n = 0; n <= text.size(); ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+            pj_set_options(&parser, PJ_OPT_NUM_INT);
+
+            const string head = text.substr(0, n), tail = text.substr(n);
+            array<pj_token, 2> tokens;
+
+            pj_feed(&parser, head);
+            pj_poll(&parser, tokens.data(), tokens.size());
+            ASSERT_EQ( PJ_STARVING, tokens[0].token_type );
+
+            pj_feed(&parser, tail);
+            pj_poll(&parser, tokens.data(), tokens.size());
+            ASSERT_EQ( PJ_STARVING, tokens[0].token_type );
+
+            pj_feed_end(&parser);
+            pj_poll(&parser, tokens.data(), tokens.size());
+            ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type ) << text << " split at " << n;
+            EXPECT_EQ( text, string(tokens[0].str, tokens[0].len) );
+            EXPECT_EQ( sample.flags, tokens[0].flags ) << text << " split at " << n;
+            if (sample.flags & PJ_NUM_INT)
+                EXPECT_EQ( sample.value, tokens[0].val.i ) << text << " split at " << n;
+        }
+    }
+}
+
+TEST(number, int_disabled)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+
+    pj_feed(&parser, "42 ");
+
+    array<pj_token, 2> tokens;
+
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+    EXPECT_EQ( 0, tokens[0].flags );
+}
+
+TEST(number, int_multiple)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_NUM_INT);
+
+    pj_feed(&parser, " 41,-43 ");
+
+    array<pj_token, 3> tokens;
+
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+    EXPECT_EQ( 41, tokens[0].val.i );
+    ASSERT_EQ( PJ_TOK_NUM, tokens[1].token_type );
+    EXPECT_EQ( -43, tokens[1].val.i );
+    EXPECT_EQ( PJ_STARVING, tokens[2].token_type );
+}
+
+namespace {
+    /* parse text split between two chunks at n (token points into buf) */
+    pj_token parse_split(const string &text, size_t n, int options, vector<char> &buf)
+    {
+        pj_parser parser;
+        buf.assign(2048, 0);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options);
+
+        const string head = text.substr(0, n), tail = text.substr(n);
+        array<pj_token, 2> tokens;
+
+        pj_feed(&parser, head);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        EXPECT_EQ( PJ_STARVING, tokens[0].token_type );
+        pj_feed(&parser, tail);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        EXPECT_EQ( PJ_STARVING, tokens[0].token_type );
+        pj_feed_end(&parser);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        EXPECT_EQ( PJ_TOK_NUM, tokens[0].token_type );
+        return tokens[0];
+    }
+
+    /* same bits, but distinguish -0.0 and 0.0 */
+    bool same_double(double a, double b)
+    { return memcmp(&a, &b, sizeof(a)) == 0; }
+}
+
+TEST(number, double_values)
+{
+    const char *samples[] = {
+        "0", "-0", "0.0", "-0.0e5", "1", "-1.5", "0.1", "3.141592653589793",
+        "1e308", "1.7976931348623157e308", "1.7976931348623159e308", "1e400",
+        "2.2250738585072011e-308", "2.2250738585072014E-308", "4.9e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+        "9007199254740993", "9007199254740992.5", "7.2057594037927933e16",
+        "123456789012345678901234567890", "0.000000000000000000000000000001",
+        "-2.5e-3", "1E+2", "5e-1", "89255.0e-22", "8.988465674311580536566680e307",
+        /* halfway between two doubles, decided by far digits */
+        "9007199254740993.0000000000000000000000000000000000000001",
+        "9007199254740992.9999999999999999999999999999999999999999",
+    };
+
+    vector<char> buf;
+    for (auto sample : samples)
+    {
+        const string text = sample;
+        const double expected = strtod(sample, NULL);
+        for (size_t n = 0; n <= text.size(); ++n)
+        {
+            const pj_token token = parse_split(text, n, PJ_OPT_NUM_DOUBLE, buf);
+            ASSERT_EQ( PJ_NUM_DOUBLE, token.flags ) << text << " split at " << n;
+            EXPECT_PRED2( same_double, expected, token.val.d ) << text << " split at " << n;
+        }
+
+        const pj_token token = parse_split(text, 0, 0, buf);
+        EXPECT_PRED2( same_double, expected, pj_token_to_double(&token) ) << text;
+    }
+}
+
+TEST(number, double_long)
+{
+    /* more digits than fallback keeps */
+    vector<char> buf;
+    for (char last : { '0', '1' })
+    {
+        const string text = "1" + string(900, '0') + "." + string(900, '0') + last + "e-900";
+        const double expected = strtod(text.c_str(), NULL);
+
+        const pj_token token = parse_split(text, text.size() / 2, PJ_OPT_NUM_DOUBLE, buf);
+        EXPECT_PRED2( same_double, expected, token.val.d ) << text;
+        EXPECT_PRED2( same_double, expected, pj_token_to_double(&token) ) << text;
+    }
+}
+
+TEST(number, double_random)
+{
+    mt19937_64 rng(42);
+    vector<char> buf;
+
+    for (int i = 0; i < 200000; ++i)
+    {
+        string text;
+        if (rng() % 2) text += '-';
+        const size_t digits = 1 + rng() % 25;
+        const size_t point = rng() % (digits + 1);
+        text += to_string(1 + rng() % 9);
+        for (size_t k = 1; k < digits; ++k)
+        {
+            if (k == point) text += '.';
+            text += to_string(rng() % 10);
+        }
+        if (rng() % 4) text += "e" + to_string((int)(rng() % 700) - 350);
+
+        const double expected = strtod(text.c_str(), NULL);
+        const pj_token token = parse_split(text, rng() % (text.size() + 1), PJ_OPT_NUM_DOUBLE, buf);
+        ASSERT_PRED2( same_double, expected, token.val.d ) << text;
+    }
+}
+
+TEST(number, double_and_int)
+{
+    const int options = PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE;
+    vector<char> buf;
+
+    pj_token token = parse_split("-42", 1, options, buf);
+    EXPECT_EQ( PJ_NUM_INT, token.flags );
+    EXPECT_EQ( -42, token.val.i );
+    EXPECT_EQ( -42.0, pj_token_to_double(&token) );
+
+    token = parse_split("42.5", 1, options, buf);
+    EXPECT_EQ( PJ_NUM_DOUBLE, token.flags );
+    EXPECT_EQ( 42.5, token.val.d );
+
+    token = parse_split("18446744073709551616", 1, options, buf);
+    EXPECT_EQ( PJ_NUM_DOUBLE | PJ_NUM_OVERFLOW, token.flags );
+    EXPECT_EQ( 18446744073709551616.0, token.val.d );
+
+    token = parse_split("18446744073709551616", 1, PJ_OPT_NUM_INT, buf);
+    EXPECT_EQ( PJ_NUM_INT | PJ_NUM_OVERFLOW, token.flags );
+    EXPECT_EQ( 18446744073709551616.0, pj_token_to_double(&token) );
+
+    /* integer zero keeps its sign as double */
+    token = parse_split("-0", 1, PJ_OPT_NUM_INT, buf);
+    EXPECT_EQ( PJ_NUM_INT, token.flags );
+    EXPECT_EQ( 0, token.val.i );
+    EXPECT_PRED2( same_double, -0.0, pj_token_to_double(&token) );
+
+    token = parse_split("0", 1, PJ_OPT_NUM_INT, buf);
+    EXPECT_PRED2( same_double, 0.0, pj_token_to_double(&token) );
+}
@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of tokens with sample fed by chunks of n bytes (followed by
+     * garbage when padded)
+     */
+    string parse(const string &sample, size_t n, bool padded, int options = 0)
+    {
+        static const char garbage[] = "0\"\\ 9e.:{}[],\t/*\x01tru";
+        pj_parser parser;
+        char buf[1024];
+        pj_init(&parser, buf, sizeof(buf));
+        pj_set_options(&parser, options);
+
+        pj_chunks chunks; /* tokens point into copies */
+        for (size_t offset = 0; offset < sample.size(); offset += n)
+        {
+            const size_t len = min(n, sample.size() - offset);
+            string chunk = sample.substr(offset, len);
+            for (size_t i = len; i < len + PJ_PADDING; ++i) chunk += garbage[i % (sizeof(garbage) - 1)];
+            chunks.copies.push_back(chunk);
+            chunks.pieces.emplace_back(chunks.copies.back().data(), len);
+        }
+
+        pj_feed_fn feed = ::pj_feed;
+        if (padded) feed = pj_feed_padded;
+        return pj_dump_chunks(&parser, chunks, [](string &dump, const pj_token &token) {
+            switch (token.token_type)
+            {
+            case PJ_TOK_STR:
+            case PJ_TOK_NUM:
+                dump += string(token.str, token.len) + " ";
+                break;
+            default: dump += to_string(token.token_type) + " ";
+            }
+        }, feed);
+    }
+}
+
+TEST(padded, same_as_feed)
+{
+    const string sample =
+        "{\"id\": 1234567890123, \"name\":\"long enough name for a vector block\","
+        " \"list\": [true, false, null, -0.000125e+10, 12345678.87654321E-3],"
+        "                                      \"esc\": \"a\\tb\\u00e9\" /* c */,"
+        " \"x\" : [ {}, [] , \"\"]}";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+    {
+        for (int options : { 0, (int)PJ_OPT_NUM_INT, (int)(PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE), (int)PJ_OPT_UTF8 })
+        {
+            const string expected = parse(sample, n, false, options);
+            ASSERT_EQ( expected, parse(sample, n, true, options) ) << "chunks of " << n;
+        }
+    }
+    EXPECT_EQ( "9 id 10 1234567890123 ", parse(sample, sample.size(), true).substr(0, 22) );
+}
+
+TEST(padded, errors)
+{
+    const char * const samples[] = { "[tru]", "[nul", "[1.e5]", "[01]", "[\"a\x01\"]", "[1 2]" };
+    for (const char *s : samples)
+    {
+        const string sample = s;
+        for (size_t n = 1; n <= sample.size(); ++n)
+            ASSERT_EQ( parse(sample, n, false), parse(sample, n, true) ) << "chunks of " << n << " for " << s;
+    }
+}
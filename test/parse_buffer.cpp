@@ -0,0 +1,199 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* token with everything that is defined for its type */
+    string dump_token(const pj_token &token, int options, bool keys)
+    {
+        string dump = to_string(token.token_type);
+        if (token.token_type < PJ_TOK_NULL) return dump; /* terminal */
+
+        dump += "/" + to_string(token.depth) + "/" + to_string(token.flags);
+        switch (token.token_type)
+        {
+        case PJ_TOK_KEY:
+            if (keys) dump += "#" + to_string(token.val.key);
+            if (!(options & PJ_OPT_FUSED_KEY)) break;
+            /* fall through */
+        case PJ_TOK_STR:
+        case PJ_TOK_STR_PART:
+        case PJ_TOK_NUM:
+            dump += ":" + string(token.str, token.len);
+            break;
+        default: ;
+        }
+        if (token.flags & PJ_STR_KEY) dump += "#" + to_string(token.val.key);
+        if (token.flags & PJ_NUM_INT) dump += "#" + to_string(token.val.i);
+        if (token.flags & PJ_NUM_DOUBLE) dump += "#" + to_string(token.val.d);
+        return dump + " ";
+    }
+
+    void setup(pj_parser &parser, vector<char> &buf, int options, pj_keys *keys)
+    {
+        static const char * const names[] = { "id", "name", "list" };
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options);
+        if (keys != nullptr) pj_set_keys(&parser, keys, names, 3);
+    }
+
+    /* dump of tokens with document fed at once and polled */
+    string poll(const string &doc, int options, size_t buf_len, pj_keys *keys = nullptr)
+    {
+        pj_parser parser;
+        vector<char> buf(buf_len);
+        setup(parser, buf, options, keys);
+        pj_feed(&parser, doc);
+
+        string dump;
+        for (;;)
+        {
+            pj_token token;
+            pj_poll(&parser, &token, 1);
+            if (token.token_type == PJ_STARVING)
+            {
+                pj_feed_end(&parser);
+                continue;
+            }
+            dump += dump_token(token, options, keys != nullptr);
+            if (token.token_type < PJ_TOK_NULL) return dump;
+        }
+    }
+
+    /* same with pj_parse_buffer() filling batches of n tokens */
+    string parse(const string &doc, int options, size_t buf_len, size_t n, pj_keys *keys = nullptr)
+    {
+        pj_parser parser;
+        vector<char> buf(buf_len);
+        setup(parser, buf, options, keys);
+
+        string dump;
+        const char *p = doc.data();
+        for (;;)
+        {
+            vector<pj_token> tokens(n);
+            const size_t count = pj_parse_buffer(&parser, p, doc.size(), tokens.data(), n);
+            p = nullptr;
+            for (size_t i = 0; i < count; ++i) dump += dump_token(tokens[i], options, keys != nullptr);
+            if (count == n) continue;
+            dump += dump_token(tokens[count], options, keys != nullptr);
+            return dump;
+        }
+    }
+}
+
+TEST(parse_buffer, same_as_poll)
+{
+    const string samples[] = {
+        "{\"id\": 1234567890123, \"name\":\"long enough name for a vector block\","
+        " \"list\": [true, false, null, -0.000125e+10, 12345678.87654321E-3, 0, -0, 1e5, 2E+1],"
+        "   \"esc\": \"a\\tb\\u00e9\" /* c */,\n\t\"x\" : [ {}, [] , \"\", {\"a\": {\"b\": []}}]}",
+        "  [ 1 , 2 // line comment\n , \"\xd0\xba\" ]  ",
+        "12345", "-1.5e-3", "\"top\"", "true", "null ", "[]", " {} ",
+        "{\"id\" /* before colon */ : 1, \"name\"\n:\n\"x\\\"y\"}",
+        "[99999999999999999999999, -9223372036854775808, 9223372036854775807]",
+    };
+    const int options[] = {
+        0, PJ_OPT_NUM_INT, PJ_OPT_NUM_INT | PJ_OPT_NUM_DOUBLE, PJ_OPT_FUSED_KEY, PJ_OPT_UTF8,
+        PJ_OPT_RAW_STR, PJ_OPT_STR_PARTS, PJ_OPT_CONTIGUOUS | PJ_OPT_FUSED_KEY,
+    };
+
+    for (const string &doc : samples)
+    {
+        for (int opts : options)
+        {
+            const string expected = poll(doc, opts, 256);
+            for (size_t n : { 1, 2, 3, 7, 64 })
+                ASSERT_EQ( expected, parse(doc, opts, 256, n) ) << doc << " options " << opts << " by " << n;
+
+            pj_keys keys;
+            const string expected_keys = poll(doc, opts, 256, &keys);
+            ASSERT_EQ( expected_keys, parse(doc, opts, 256, 5, &keys) ) << doc << " options " << opts;
+        }
+    }
+}
+
+TEST(parse_buffer, errors)
+{
+    const char * const samples[] = {
+        "", "[", "[1,", "{\"a\"", "{\"a\":", "{\"a\" 1}", "[1 2]", "[tru]", "[nul", "[1.e5]",
+        "[01]", "[-]", "[1.5.5]", "[1e]", "[\"a\x01\"]", "[\"abc", "{]", "[}", "]", "{\"a\":1]",
+        "[1]]", "[1] 2", "[/x]", "[/* open", "{,}", "[,1]", "[\"\\q\"]", "[1-2]", "falsy", "[0x1]",
+    };
+
+    for (const char *s : samples)
+    {
+        const string doc = s;
+        for (int opts : { 0, (int)PJ_OPT_NUM_INT, (int)PJ_OPT_FUSED_KEY })
+        {
+            const string expected = poll(doc, opts, 256);
+            ASSERT_EQ( expected, parse(doc, opts, 256, 1) ) << doc;
+            ASSERT_EQ( expected, parse(doc, opts, 256, 16) ) << doc;
+        }
+    }
+}
+
+TEST(parse_buffer, nesting)
+{
+    string doc;
+    for (size_t i = 0; i < PJ_MAX_DEPTH + 1; ++i) doc += i % 2 ? "{\"k\":" : "[";
+    EXPECT_EQ( poll(doc, 0, 0), parse(doc, 0, 0, 1000) );
+}
+
+TEST(parse_buffer, overflow)
+{
+    /* string with escape is formed in buffer; continue after pj_realloc() */
+    const string doc = "[\"long string with \\\"escape\\\" in it\", 12345]";
+    pj_parser parser;
+    pj_init(&parser, nullptr, 0);
+
+    pj_token tokens[4];
+    ASSERT_EQ( 1, pj_parse_buffer(&parser, doc.data(), doc.size(), tokens, 4) );
+    EXPECT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+    ASSERT_EQ( PJ_OVERFLOW, tokens[1].token_type );
+
+    vector<char> buf(tokens[1].len);
+    pj_realloc(&parser, buf.data(), buf.size());
+    ASSERT_EQ( 3, pj_parse_buffer(&parser, nullptr, 0, tokens, 4) );
+    EXPECT_EQ( "long string with \"escape\" in it", string(tokens[0].str, tokens[0].len) );
+    EXPECT_EQ( "12345", string(tokens[1].str, tokens[1].len) );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[2].token_type );
+    EXPECT_EQ( PJ_END, tokens[3].token_type );
+}
+
+TEST(parse_buffer, projection)
+{
+    const string doc = "{\"a\": [1, 2], \"b\": {\"c\": 3}}";
+    const char * const paths[] = { "/b/c" };
+    pj_projection proj;
+
+    pj_parser parser;
+    pj_init(&parser, nullptr, 0);
+    ASSERT_EQ( 0, pj_set_projection(&parser, &proj, paths, 1) );
+    pj_feed(&parser, doc);
+    string expected;
+    for (;;)
+    {
+        pj_token token;
+        pj_poll(&parser, &token, 1);
+        if (token.token_type == PJ_STARVING)
+        {
+            pj_feed_end(&parser);
+            continue;
+        }
+        expected += dump_token(token, 0, false);
+        if (token.token_type < PJ_TOK_NULL) break;
+    }
+
+    pj_init(&parser, nullptr, 0);
+    ASSERT_EQ( 0, pj_set_projection(&parser, &proj, paths, 1) );
+    vector<pj_token> tokens(16);
+    const size_t count = pj_parse_buffer(&parser, doc.data(), doc.size(), tokens.data(), tokens.size());
+    string dump;
+    for (size_t i = 0; i <= count; ++i) dump += dump_token(tokens[i], 0, false);
+    EXPECT_EQ( expected, dump );
+}
@@ -0,0 +1,160 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of tokens with sample fed by chunks of n bytes; pieces of string
+     * are joined with '|' and ones that point into sample are marked with '@'
+     */
+    string parse(const string &sample, size_t n, int options, size_t buf_len = 32)
+    {
+        pj_parser parser;
+        vector<char> buf(buf_len);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options | PJ_OPT_STR_PARTS);
+
+        return pj_dump_chunks(&parser, pj_chunks_by(sample, n), [&](string &dump, const pj_token &token) {
+            const string mark = pj_in_sample(sample, token) ? "@" : "";
+            switch (token.token_type)
+            {
+            case PJ_TOK_STR_PART:
+                EXPECT_LT( 0, token.len );
+                dump += mark + string(token.str, token.len) + "|";
+                break;
+            case PJ_TOK_STR:
+                dump += mark + string(token.str, token.len) + " ";
+                break;
+            default: dump += to_string(token.token_type) + " ";
+            }
+        });
+    }
+
+    /* string tokens joined with '|' after each piece; buffer of buf_len bytes
+     * grows on overflow
+     */
+    string parse_growing(const pj_chunks &chunks, size_t buf_len)
+    {
+        pj_parser parser;
+        vector<char> buf(buf_len);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, PJ_OPT_STR_PARTS);
+
+        string dump;
+        pj_feed_chunks(&parser, chunks, [&]() -> bool {
+            for (;;)
+            {
+                pj_token token;
+                pj_poll(&parser, &token, 1);
+                switch (token.token_type)
+                {
+                case PJ_STARVING: return true;
+                case PJ_END: return false;
+                case PJ_ERR: dump += "!"; return false;
+                case PJ_OVERFLOW:
+                {
+                    vector<char> bigger(token.len);
+                    pj_realloc(&parser, bigger.data(), bigger.size());
+                    buf.swap(bigger);
+                    break;
+                }
+                case PJ_TOK_STR_PART: dump += string(token.str, token.len) + "|"; break;
+                case PJ_TOK_STR: dump += string(token.str, token.len); break;
+                default: ;
+                }
+            }
+        });
+        return dump;
+    }
+
+    /* dump without marks and piece boundaries */
+    string joined(string dump)
+    {
+        string s;
+        for (char c : dump) if (c != '@' && c != '|') s += c;
+        return s;
+    }
+}
+
+TEST(parts, joined)
+{
+    const string sample =
+        "{\"name\": \"long enough name\", \"esc\\taped key\": \"x\\\"y\\u0041\\\\z\\/\","
+        " \"tags\": [\"a\", \"b\\nc\", \"\"], \"n\": 1}";
+    const string expected = "9 name 10 long enough name esc\taped key 10 x\"yA\\z/ tags 10 12 a b\nc  13 n 10 8 11 ";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+    {
+        ASSERT_EQ( expected, joined(parse(sample, n, 0)) ) << "chunks of " << n;
+        ASSERT_EQ( expected, joined(parse(sample, n, PJ_OPT_CONTIGUOUS)) ) << "chunks of " << n;
+    }
+}
+
+TEST(parts, pieces)
+{
+    const string sample = "[\"abcdefgh\", \"ab\\tcdefgh\", {\"key\": 1}]";
+
+    /* plain pieces are slices of input, escaped ones are formed in buffer
+     * and keys are not split
+     */
+    EXPECT_EQ( "12 @ab|@cdef|@gh @ab|\tcd|@efgh|@ 9 key 10 8 11 13 ", parse(sample, 4, 0) );
+
+    /* buffer holds only piece of one chunk */
+    const string big = "[\"" + string(1000, 'x') + "\\n" + string(1000, 'y') + "\"]";
+    EXPECT_EQ( "12 " + string(1000, 'x') + "\n" + string(1000, 'y') + " 13 ", joined(parse(big, 16, 0, 16)) );
+}
+
+TEST(parts, compact)
+{
+    const string sample = "[\"abcdefgh\", \"x\\ty\"]";
+
+    pj_parser parser;
+    char buf[16];
+    pj_init(&parser, buf, sizeof(buf));
+    pj_set_options(&parser, PJ_OPT_STR_PARTS);
+    pj_feed(&parser, sample.data(), 6);
+
+    array<pj_ctoken, 4> tokens;
+    ASSERT_EQ( 2, pj_poll_compact(&parser, tokens.data(), tokens.size()) );
+    EXPECT_EQ( PJ_TOK_STR_PART, PJ_CTOK_TYPE(&tokens[1]) );
+    EXPECT_EQ( "abcd", string(PJ_CTOK_STR(&parser, &tokens[1]), PJ_CTOK_LEN(&tokens[1])) );
+
+    pj_feed(&parser, sample.data() + 6, sample.size() - 6);
+    ASSERT_EQ( 3, pj_poll_compact(&parser, tokens.data(), tokens.size()) );
+    EXPECT_EQ( PJ_TOK_STR, PJ_CTOK_TYPE(&tokens[0]) );
+    EXPECT_EQ( "efgh", string(PJ_CTOK_STR(&parser, &tokens[0]), PJ_CTOK_LEN(&tokens[0])) );
+    EXPECT_EQ( "x\ty", string(PJ_CTOK_STR(&parser, &tokens[1]), PJ_CTOK_LEN(&tokens[1])) );
+}
+
+TEST(parts, escapes_overflow)
+{
+    /* piece that waits for bigger buffer is retried from where string was
+     * cut, not from escape that was pending before it
+     */
+    const struct {
+        string sample, expected;
+        size_t buf_len;
+    } cases[] = {
+        { "\t\"\\nwwzj\xd0\x96\"", "\nwwzj\xd0\x96", 3 },
+        { "\"\\u0416\\u0416\xd0\x96\\u0416u\\ud83d\\ude00\\u0416x\\ty\"",
+          "\xd0\x96\xd0\x96\xd0\x96\xd0\x96u\xf0\x9f\x98\x80\xd0\x96x\ty", 7 },
+    };
+
+    for (const auto &c : cases)
+    {
+        for (size_t i = 0; i <= c.sample.size(); ++i)
+        {
+            for (size_t j = i; j <= c.sample.size(); ++j)
+            {
+                const string dump = parse_growing(pj_chunks_split(c.sample, { i, j }), c.buf_len);
+                string s;
+                for (char ch : dump) if (ch != '|') s += ch;
+                ASSERT_EQ( c.expected, s ) << dump << " split at " << i << " and " << j;
+            }
+        }
+    }
+}
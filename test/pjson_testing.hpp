@@ -1,13 +1,106 @@
 #ifndef __pjson_hpp__
 #define __pjson_hpp__
 
+#include <algorithm>
+#include <initializer_list>
+#include <list>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "pjson.h"
 
 namespace {
     void pj_feed(pj_parser_ref parser, const std::string &s)
     { pj_feed(parser, s.data(), s.size()); }
+
+    /* literals outlive temporary std::string that parser would point into */
+    template <size_t N>
+    void pj_feed(pj_parser_ref parser, const char (&s)[N])
+    { pj_feed(parser, s, N - 1); }
+
+    /* pieces of sample as they are fed to parser */
+    struct pj_chunks {
+        std::vector<std::pair<const char *, size_t>> pieces;
+        std::list<std::string> copies; /* storage of pieces that aren't in sample */
+    };
+
+    /* pieces of n bytes right in sample (tokens may point into it) */
+    pj_chunks pj_chunks_by(const std::string &sample, size_t n)
+    {
+        pj_chunks chunks;
+        for (size_t offset = 0; offset < sample.size(); offset += n)
+            chunks.pieces.emplace_back(sample.data() + offset, std::min(n, sample.size() - offset));
+        return chunks;
+    }
+
+    /* copies of sample split at ascending offsets (pieces may be empty) */
+    pj_chunks pj_chunks_split(const std::string &sample, std::initializer_list<size_t> cuts)
+    {
+        pj_chunks chunks;
+        size_t offset = 0;
+        for (size_t cut : cuts)
+        {
+            chunks.copies.push_back(sample.substr(offset, cut - offset));
+            offset = cut;
+        }
+        chunks.copies.push_back(sample.substr(offset));
+        for (const std::string &piece : chunks.copies)
+            chunks.pieces.emplace_back(piece.data(), piece.size());
+        return chunks;
+    }
+
+    /* copies of sample split at n (first one is empty for n == 0) */
+    pj_chunks pj_chunks_split(const std::string &sample, size_t n)
+    { return pj_chunks_split(sample, { n }); }
+
+    /* whether str of token points into sample rather than into buffer */
+    bool pj_in_sample(const std::string &sample, const pj_token &token)
+    { return sample.data() <= token.str && token.str < sample.data() + sample.size(); }
+
+    typedef void (*pj_feed_fn)(pj_parser_ref parser, const char *chunk, size_t len);
+
+    /* feed chunks and then pj_feed_end() calling drain() after each of them;
+     * drain() polls till PJ_STARVING (returns true) or till the end (false)
+     */
+    template <typename Drain>
+    void pj_feed_chunks(pj_parser_ref parser, const pj_chunks &chunks, Drain drain, pj_feed_fn feed = ::pj_feed)
+    {
+        for (const auto &piece : chunks.pieces)
+        {
+            feed(parser, piece.first, piece.second);
+            if (!drain()) return;
+        }
+        pj_feed_end(parser);
+        (void) drain();
+    }
+
+    /* dump of tokens polled one at a time while chunks are fed; dump_token()
+     * appends non-terminal ones and terminal ones finish dump (with "!" for
+     * PJ_ERR and "overflow" for PJ_OVERFLOW)
+     */
+    template <typename DumpToken>
+    std::string pj_dump_chunks(pj_parser_ref parser, const pj_chunks &chunks, DumpToken dump_token,
+                               pj_feed_fn feed = ::pj_feed)
+    {
+        std::string dump;
+        pj_feed_chunks(parser, chunks, [&]() -> bool {
+            for (;;)
+            {
+                pj_token token;
+                pj_poll(parser, &token, 1);
+                switch (token.token_type)
+                {
+                case PJ_STARVING: return true;
+                case PJ_END: return false;
+                case PJ_ERR: dump += "!"; return false;
+                case PJ_OVERFLOW: dump += "overflow"; return false;
+                default: dump_token(dump, token);
+                }
+            }
+        }, feed);
+        return dump;
+    }
 }
 
 #endif
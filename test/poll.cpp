@@ -0,0 +1,97 @@
+#include <array>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+TEST(poll, count)
+{
+    pj_parser parser;
+    char buf[256];
+    pj_init(&parser, buf, sizeof(buf));
+
+    pj_feed(&parser, "[1, \"a\", null, [");
+    array<pj_token, 8> tokens;
+    pj_token terminal;
+    terminal.token_type = PJ_TOK_NULL;
+
+    /* batch filled with normal tokens, terminal isn't touched */
+    ASSERT_EQ( 3, pj_poll_n(&parser, tokens.data(), 3, &terminal) );
+    EXPECT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+    EXPECT_EQ( PJ_TOK_NUM, tokens[1].token_type );
+    EXPECT_EQ( PJ_TOK_STR, tokens[2].token_type );
+    EXPECT_EQ( PJ_TOK_NULL, terminal.token_type );
+
+    ASSERT_EQ( 2, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_TOK_NULL, tokens[0].token_type );
+    EXPECT_EQ( PJ_TOK_ARR, tokens[1].token_type );
+    EXPECT_EQ( PJ_STARVING, terminal.token_type );
+
+    pj_feed(&parser, "]]");
+    ASSERT_EQ( 2, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[0].token_type );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[1].token_type );
+    EXPECT_EQ( PJ_STARVING, terminal.token_type );
+
+    pj_feed_end(&parser);
+
+    ASSERT_EQ( 0, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_END, terminal.token_type );
+}
+
+TEST(poll, count_err)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+
+    pj_feed(&parser, "[1, }");
+    array<pj_token, 8> tokens;
+    pj_token terminal;
+    ASSERT_EQ( 2, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_ERR, terminal.token_type );
+}
+
+TEST(poll, count_overflow)
+{
+    pj_parser parser;
+    char buf[4];
+    pj_init(&parser, buf, sizeof(buf));
+
+    pj_feed(&parser, "[\"a\\tlong string\"]");
+    array<pj_token, 8> tokens;
+    pj_token terminal;
+    ASSERT_EQ( 1, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_OVERFLOW, terminal.token_type );
+    EXPECT_LT( sizeof(buf), terminal.len );
+
+    char bigger[64];
+    pj_realloc(&parser, bigger, sizeof(bigger));
+    ASSERT_EQ( 2, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( "a\tlong string", string(tokens[0].str, tokens[0].len) );
+    EXPECT_EQ( PJ_STARVING, terminal.token_type );
+}
+
+TEST(poll, count_held)
+{
+    const string sample = "[\"" + string(PJ_CTOK_LEN_MAX + 1, 'x') + "\", 1]";
+
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_feed(&parser, sample);
+
+    array<pj_ctoken, 4> ctokens;
+    ASSERT_EQ( 1, pj_poll_compact(&parser, ctokens.data(), ctokens.size()) );
+    EXPECT_EQ( PJ_CTOK_LONG, PJ_CTOK_TYPE(&ctokens[1]) );
+
+    /* token held by compact poll is followed by the rest of queue */
+    array<pj_token, 4> tokens;
+    pj_token terminal;
+    ASSERT_EQ( 3, pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal) );
+    EXPECT_EQ( PJ_TOK_STR, tokens[0].token_type );
+    EXPECT_EQ( PJ_CTOK_LEN_MAX + 1, tokens[0].len );
+    EXPECT_EQ( PJ_TOK_NUM, tokens[1].token_type );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[2].token_type );
+    EXPECT_EQ( PJ_STARVING, terminal.token_type );
+}
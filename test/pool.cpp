@@ -0,0 +1,105 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of strings and numbers with sample split at n */
+    string parse(const string &sample, size_t n, pj_pool &pool)
+    {
+        pj_parser parser;
+        pj_init_pool(&parser, &pool);
+
+        const string dump = pj_dump_chunks(&parser, pj_chunks_split(sample, n), [](string &dump, const pj_token &token) {
+            if (token.token_type == PJ_TOK_STR || token.token_type == PJ_TOK_NUM)
+                dump += string(token.str, token.len) + " ";
+        });
+        pj_done(&parser);
+        return dump;
+    }
+}
+
+TEST(pool, init)
+{
+    pj_pool pool;
+    char slab[100];
+    pj_pool_init(&pool, slab, sizeof(slab), 32);
+    EXPECT_EQ( 3, pool.nfree );
+    EXPECT_EQ( 32, pool.block_len );
+}
+
+TEST(pool, borrow)
+{
+    pj_pool pool;
+    char slab[64];
+    pj_pool_init(&pool, slab, sizeof(slab), sizeof(slab));
+
+    const string sample = "{\"name\": \"x\\ty\", \"tags\": [\"a\", 12345, true]}";
+    const string expected = "name x\ty tags a 12345 ";
+    for (size_t n = 0; n <= sample.size(); ++n)
+    {
+        ASSERT_EQ( expected, parse(sample, n, pool) ) << "split at " << n;
+        ASSERT_EQ( 1, pool.nfree ) << "split at " << n;
+    }
+
+    /* doesn't fit into block */
+    EXPECT_EQ( "overflow", parse("\"" + string(100, 'x') + "\\n\"", 0, pool) );
+    EXPECT_EQ( 1, pool.nfree );
+}
+
+TEST(pool, shared)
+{
+    pj_pool pool;
+    char slab[2 * 64];
+    pj_pool_init(&pool, slab, sizeof(slab), 64);
+
+    /* idle parsers don't hold blocks */
+    array<pj_parser, 8> parsers;
+    array<pj_token, 4> tokens;
+    const string head = "[\"abc\", ";
+    for (auto &parser : parsers)
+    {
+        pj_init_pool(&parser, &pool);
+        pj_feed(&parser, head);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        ASSERT_EQ( PJ_STARVING, tokens[2].token_type );
+    }
+    EXPECT_EQ( 2, pool.nfree );
+
+    /* but ones in the middle of token do */
+    const string part = "\"de";
+    for (size_t i = 0; i < 3; ++i)
+    {
+        pj_feed(&parsers[i], part);
+        pj_poll(&parsers[i], tokens.data(), tokens.size());
+    }
+    EXPECT_EQ( PJ_OVERFLOW, tokens[0].token_type ); /* third one */
+    EXPECT_EQ( 0, pool.nfree );
+
+    /* the one that didn't get a block continues when it's returned */
+    const string tail = "f\"]";
+    pj_feed(&parsers[0], tail);
+    pj_poll(&parsers[0], tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_STR, tokens[0].token_type );
+    EXPECT_EQ( "def", string(tokens[0].str, tokens[0].len) );
+    EXPECT_EQ( 0, pool.nfree );
+    pj_feed_end(&parsers[0]);
+    pj_poll(&parsers[0], tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_END, tokens[0].token_type );
+    EXPECT_EQ( 1, pool.nfree );
+
+    pj_poll(&parsers[2], tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_STARVING, tokens[0].token_type );
+    EXPECT_EQ( 0, pool.nfree );
+    pj_feed(&parsers[2], tail);
+    pj_poll(&parsers[2], tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_STR, tokens[0].token_type );
+    EXPECT_EQ( "def", string(tokens[0].str, tokens[0].len) );
+
+    for (auto &parser : parsers) pj_done(&parser);
+    EXPECT_EQ( 2, pool.nfree );
+}
@@ -0,0 +1,149 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* compact dump of tokens left after projection of sample split at n */
+    string project(const string &sample, vector<const char *> paths, size_t n)
+    {
+        pj_parser parser;
+        pj_projection proj;
+        char buf[256];
+        pj_init(&parser, buf, sizeof(buf));
+        EXPECT_EQ( 0, pj_set_projection(&parser, &proj, paths.data(), paths.size()) );
+
+        string dump;
+        const string chunks[] = { sample.substr(0, n), sample.substr(n) };
+        for (size_t i = 0; i <= 2; ++i)
+        {
+            if (i < 2) pj_feed(&parser, chunks[i]);
+            else pj_feed_end(&parser);
+            for (bool starving = false; !starving;)
+            {
+                array<pj_token, 4> tokens;
+                pj_poll(&parser, tokens.data(), tokens.size());
+                for (auto &token : tokens)
+                {
+                    switch (token.token_type)
+                    {
+                    case PJ_STARVING: starving = true; break;
+                    case PJ_END: return dump;
+                    case PJ_ERR: return dump + "!";
+                    case PJ_OVERFLOW: return dump + "?";
+                    case PJ_TOK_NULL: dump += "null "; break;
+                    case PJ_TOK_TRUE: dump += "true "; break;
+                    case PJ_TOK_FALSE: dump += "false "; break;
+                    case PJ_TOK_STR: dump += "\"" + string(token.str, token.len) + "\" "; break;
+                    case PJ_TOK_NUM: dump += string(token.str, token.len) + " "; break;
+                    case PJ_TOK_KEY: dump += ": "; break;
+                    case PJ_TOK_MAP: dump += "{ "; break;
+                    case PJ_TOK_MAP_E: dump += "} "; break;
+                    case PJ_TOK_ARR: dump += "[ "; break;
+                    case PJ_TOK_ARR_E: dump += "] "; break;
+                    }
+                    if (starving) break;
+                }
+            }
+        }
+        return dump;
+    }
+
+    const string sample =
+        "{\"user\": {\"id\": 42, \"name\": \"a\\\"b\", \"tags\": [\"x\", {\"id\": 0}]},"
+        " \"events\": [{\"ts\": 1, \"data\": {\"ts\": -1}}, {\"data\": [1, 2]}, {\"ts\": 3}],"
+        " \"id\": 7}";
+}
+
+TEST(projection, paths)
+{
+    const struct { vector<const char *> paths; string expected; } cases[] = {
+        { { "/user/id" }, "{ \"user\" : { \"id\" : 42 } } " },
+        { { "/events/*/ts" }, "{ \"events\" : [ { \"ts\" : 1 } { } { \"ts\" : 3 } ] } " },
+        { { "/user/tags" }, "{ \"user\" : { \"tags\" : [ \"x\" { \"id\" : 0 } ] } } " },
+        { { "/user/tags/*/id" }, "{ \"user\" : { \"tags\" : [ \"x\" { \"id\" : 0 } ] } } " },
+        { { "/id", "/user/name" }, "{ \"user\" : { \"name\" : \"a\"b\" } \"id\" : 7 } " },
+        { { "/*/id" }, "{ \"user\" : { \"id\" : 42 } \"events\" : [ ] \"id\" : 7 } " },
+        { { "/events/*/data/*" },
+          "{ \"events\" : [ { \"data\" : { \"ts\" : -1 } } { \"data\" : [ 1 2 ] } { } ] } " },
+        { { "/missing" }, "{ } " },
+        { { }, "{ } " },
+        { { "" }, "" }, /* filled in below */
+    };
+
+    for (auto &c : cases)
+    {
+        string expected = c.expected;
+        if (c.paths.size() == 1 && c.paths[0][0] == '\0') expected = project(sample, { "/user", "/events", "/id" }, 0);
+        for (size_t n = 0; n <= sample.size(); ++n)
+            ASSERT_EQ( expected, project(sample, c.paths, n) ) << c.paths.size() << " split at " << n;
+    }
+}
+
+TEST(projection, depth)
+{
+    pj_parser parser;
+    pj_projection proj;
+    char buf[256];
+    pj_init(&parser, buf, sizeof(buf));
+
+    const char *paths[] = { "/a/b" };
+    ASSERT_EQ( 0, pj_set_projection(&parser, &proj, paths, 1) );
+    pj_feed(&parser, "{\"a\": {\"c\": [1], \"b\": [2]}, \"b\": 3}");
+
+    array<pj_token, 12> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+
+    /* depth of kept tokens is not affected by dropped ones */
+    const struct { pj_token_type type; int depth; } expected[] = {
+        { PJ_TOK_MAP, 0 },
+        { PJ_TOK_STR, 1 },
+        { PJ_TOK_KEY, 1 },
+        { PJ_TOK_MAP, 1 },
+        { PJ_TOK_STR, 2 },
+        { PJ_TOK_KEY, 2 },
+        { PJ_TOK_ARR, 2 },
+        { PJ_TOK_NUM, 3 },
+        { PJ_TOK_ARR_E, 2 },
+        { PJ_TOK_MAP_E, 1 },
+        { PJ_TOK_MAP_E, 0 },
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        ASSERT_EQ( expected[i].type, tokens[i].token_type ) << i;
+        EXPECT_EQ( expected[i].depth, tokens[i].depth ) << i;
+    }
+    EXPECT_EQ( PJ_STARVING, tokens[11].token_type );
+}
+
+TEST(projection, bad_paths)
+{
+    pj_parser parser;
+    pj_projection proj;
+    pj_init(&parser, 0, 0);
+
+    const char *relative[] = { "a/b" };
+    EXPECT_EQ( -1, pj_set_projection(&parser, &proj, relative, 1) );
+
+    const string deep(2 * (PJ_PROJECTION_DEPTH + 1), '/');
+    const char *too_deep[] = { deep.c_str() };
+    EXPECT_EQ( -1, pj_set_projection(&parser, &proj, too_deep, 1) );
+
+    vector<const char *> many(PJ_PROJECTION_PATHS + 1, "/a");
+    EXPECT_EQ( -1, pj_set_projection(&parser, &proj, many.data(), many.size()) );
+    EXPECT_EQ( 0, pj_set_projection(&parser, &proj, many.data(), PJ_PROJECTION_PATHS) );
+    EXPECT_EQ( 0, pj_set_projection(&parser, NULL, NULL, 0) );
+}
+
+TEST(projection, many_dropped)
+{
+    /* members dropped one by one don't nest calls */
+    string sample = "{";
+    for (size_t i = 0; i < (1 << 18); ++i) sample += "\"a\": [1], ";
+    sample += "\"b\": 3}";
+    EXPECT_EQ( "{ \"b\" : 3 } ", project(sample, { "/b" }, 0) );
+}
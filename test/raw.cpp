@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of tokens with sample fed by chunks of n bytes; raw strings are
+     * marked with '~' and ones that point into sample with '@'
+     */
+    string parse(const string &sample, size_t n, int options)
+    {
+        pj_parser parser;
+        char buf[256];
+        pj_init(&parser, buf, sizeof(buf));
+        pj_set_options(&parser, options | PJ_OPT_RAW_STR);
+
+        return pj_dump_chunks(&parser, pj_chunks_by(sample, n), [&](string &dump, const pj_token &token) {
+            switch (token.token_type)
+            {
+            case PJ_TOK_STR:
+            case PJ_TOK_STR_PART:
+                dump += (pj_in_sample(sample, token) ? "@" : "") + string((token.flags & PJ_STR_ESC) ? "~" : "") +
+                        string(token.str, token.len) + (token.token_type == PJ_TOK_STR ? " " : "|");
+                break;
+            default: dump += to_string(token.token_type) + " ";
+            }
+        });
+    }
+
+    string unescape(const string &raw)
+    {
+        vector<char> out(raw.size());
+        const size_t len = pj_unescape(raw.data(), raw.size(), out.data(), out.size());
+        if (len == (size_t)-1) return "!";
+        return string(out.data(), len);
+    }
+}
+
+TEST(raw, slices)
+{
+    const string sample = "{\"a\\tb\": \"x\\\"y\\u0041\\\\\", \"c\": [\"plain\", \"\\n\", \"\\q\"]}";
+
+    /* whole sample in one chunk */
+    EXPECT_EQ( "9 a\tb 10 @~x\\\"y\\u0041\\\\ @c 10 12 @plain @~\\n @~\\q 13 11 ",
+               parse(sample, sample.size(), 0) );
+
+    const string expected = "9 a\tb 10 ~x\\\"y\\u0041\\\\ c 10 12 plain ~\\n ~\\q 13 11 ";
+    for (size_t n = 1; n <= sample.size(); ++n)
+    {
+        string dump = parse(sample, n, 0);
+        dump.erase(remove(dump.begin(), dump.end(), '@'), dump.end());
+        ASSERT_EQ( expected, dump ) << "chunks of " << n;
+    }
+}
+
+TEST(raw, contiguous)
+{
+    const string sample = "[\"x\\\"y\\u0041\\\\\", \"\\n\"]";
+    const string expected = "12 @~x\\\"y\\u0041\\\\ @~\\n 13 ";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_CONTIGUOUS) ) << "chunks of " << n;
+}
+
+TEST(raw, parts)
+{
+    /* pieces are unescaped, last one may stay raw */
+    const string sample = "[\"ab\\ncd\\tef\"]";
+    EXPECT_EQ( "12 ab\ncd|@~\\tef 13 ", parse(sample, 8, PJ_OPT_STR_PARTS) );
+    EXPECT_EQ( "12 ab\n|cd\tef|@ 13 ", parse(sample, 6, PJ_OPT_STR_PARTS) );
+    EXPECT_EQ( "12 @~ab\\ncd\\tef 13 ", parse(sample, sample.size(), PJ_OPT_STR_PARTS) );
+}
+
+TEST(raw, unescape)
+{
+    EXPECT_EQ( "plain", unescape("plain") );
+    EXPECT_EQ( "x\"y\\/\b\f\n\r\t", unescape("x\\\"y\\\\\\/\\b\\f\\n\\r\\t") );
+    EXPECT_EQ( "A", unescape("\\u0041") );
+    EXPECT_EQ( "!", unescape("\\q") );
+    EXPECT_EQ( "!", unescape("abc\\") );
+    EXPECT_EQ( "!", unescape("\\u004") );
+    EXPECT_EQ( "!", unescape("\\u00g1") );
+
+    /* only what fits is written */
+    char out[3];
+    EXPECT_EQ( 5, pj_unescape("a\\tbcd", 6, out, sizeof(out)) );
+    EXPECT_EQ( "a\tb", string(out, sizeof(out)) );
+}
+
+TEST(raw, compact)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_RAW_STR);
+    const string sample = "[\"a\", \"b\\n\"]";
+    pj_feed(&parser, sample);
+
+    /* flag doesn't fit into compact token */
+    array<pj_ctoken, 4> ctokens;
+    ASSERT_EQ( 2, pj_poll_compact(&parser, ctokens.data(), ctokens.size()) );
+    EXPECT_EQ( PJ_CTOK_LONG, PJ_CTOK_TYPE(&ctokens[2]) );
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( PJ_STR_ESC, token.flags );
+    EXPECT_EQ( "b\\n", string(token.str, token.len) );
+}
@@ -188,3 +188,76 @@ TEST(simple, comments_chunked)
     EXPECT_EQ( "7", std::string(tokens[0].str, tokens[0].len) );
     EXPECT_EQ( PJ_STARVING, tokens[1].token_type );
 }
+
+TEST(simple, long_space)
+{
+    pj_parser parser;
+
+    for (size_t n = 0; n < 70; ++n)
+    {
+        const string sample = "[" + string(n, ' ') + "\n\t" + string(n, ' ') + "1" + string(n, '\n') + "]";
+        pj_init(&parser, 0, 0);
+        pj_feed(&parser, sample);
+
+        array<pj_token, 4> tokens;
+
+        pj_poll(&parser, tokens.data(), tokens.size());
+        EXPECT_EQ( PJ_TOK_ARR, tokens[0].token_type ) << "spaces " << n;
+        ASSERT_EQ( PJ_TOK_NUM, tokens[1].token_type ) << "spaces " << n;
+        EXPECT_EQ( "1", string(tokens[1].str, tokens[1].len) );
+        EXPECT_EQ( PJ_TOK_ARR_E, tokens[2].token_type );
+        EXPECT_EQ( PJ_STARVING, tokens[3].token_type );
+    }
+}
+
+TEST(simple, long_space_comment)
+{
+    pj_parser parser;
+    const string sample = "[" + string(40, ' ') + "/* 1 */" + string(40, '\t') + "2]";
+
+    for (size_t n = 1; n < sample.size(); ++n)
+    {
+        char buf[16];
+        pj_init(&parser, buf, sizeof(buf));
+
+        array<pj_token, 4> tokens;
+
+        pj_feed(&parser, sample.data(), n);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        ASSERT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+        if (tokens[1].token_type == PJ_TOK_NUM) continue; /* whole value in first chunk */
+        ASSERT_EQ( PJ_STARVING, tokens[1].token_type ) << "split at " << n;
+
+        pj_feed(&parser, sample.data() + n, sample.size() - n);
+        pj_poll(&parser, tokens.data(), tokens.size());
+        if (n <= 48) /* "2" is not in first chunk */
+        {
+            ASSERT_EQ( PJ_TOK_NUM, tokens[0].token_type ) << "split at " << n;
+            EXPECT_EQ( "2", string(tokens[0].str, tokens[0].len) );
+        }
+    }
+}
+
+TEST(simple, many_comments)
+{
+    /* white-space and comments between tokens don't nest calls */
+    const size_t n = 1 << 18;
+    string sample = "[";
+    for (size_t i = 0; i < n; ++i) sample += " /**/\n// x\n";
+    sample += "1, /*";
+    for (size_t i = 0; i < n; ++i) sample += " * **x";
+    sample += " */ 2]";
+
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_feed(&parser, sample);
+
+    array<pj_token, 5> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_TOK_ARR, tokens[0].token_type );
+    ASSERT_EQ( PJ_TOK_NUM, tokens[1].token_type );
+    ASSERT_EQ( PJ_TOK_NUM, tokens[2].token_type );
+    EXPECT_EQ( "2", string(tokens[2].str, tokens[2].len) );
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[3].token_type );
+    EXPECT_EQ( PJ_STARVING, tokens[4].token_type );
+}
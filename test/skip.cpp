@@ -0,0 +1,209 @@
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of tokens (one poll per token) with values of keys named "skip"
+     * skipped; sample is split at n
+     */
+    vector<string> parse(const string &sample, size_t n, char *buf = nullptr, size_t buf_len = 0)
+    {
+        pj_parser parser;
+        char default_buf[256];
+        if (buf == nullptr) pj_init(&parser, default_buf, sizeof(default_buf));
+        else pj_init(&parser, buf, buf_len);
+
+        vector<string> dump;
+        string last_str;
+        pj_feed_chunks(&parser, pj_chunks_split(sample, n), [&]() -> bool {
+            for (;;)
+            {
+                pj_token token;
+                pj_poll(&parser, &token, 1);
+                if (token.token_type == PJ_STARVING) return true;
+                dump.push_back(to_string(token.token_type));
+                switch (token.token_type)
+                {
+                case PJ_END:
+                case PJ_ERR:
+                case PJ_OVERFLOW:
+                    return false;
+                case PJ_TOK_STR:
+                    last_str = string(token.str, token.len);
+                    /* fall through */
+                case PJ_TOK_NUM:
+                    dump.back() += ":" + string(token.str, token.len);
+                    break;
+                case PJ_TOK_KEY:
+                    if (last_str == "skip") EXPECT_EQ( 0, pj_skip_value(&parser) );
+                    break;
+                default: ;
+                }
+            }
+        });
+        return dump;
+    }
+}
+
+TEST(skip, values)
+{
+    const vector<string> expected = {
+        to_string(PJ_TOK_MAP),
+        to_string(PJ_TOK_STR) + ":skip", to_string(PJ_TOK_KEY),
+        to_string(PJ_TOK_STR) + ":a", to_string(PJ_TOK_KEY), to_string(PJ_TOK_NUM) + ":1",
+        to_string(PJ_TOK_STR) + ":skip", to_string(PJ_TOK_KEY),
+        to_string(PJ_TOK_MAP_E),
+        to_string(PJ_END),
+    };
+    for (auto value : {
+            "null", "true", "false", "-12.5e+3", "\"\"", "\"a\\\"b\\\\\"", "\"]}[{\"",
+            "[]", "{}", "[1, [2, 3], {\"x\": \"]\"}]",
+            "{\"x\": [\"\\\"}\", {\"y\": null}], \"z\": \"\\\\\"}",
+            "[ /* ] \" */ 1, // }\n 2]",
+        })
+    {
+        const string sample = "{\"skip\": " + string(value) + ", \"a\": 1, \"skip\":" + value + "}";
+        for (size_t n = 0; n <= sample.size(); ++n)
+            EXPECT_EQ( expected, parse(sample, n) ) << sample << " split at " << n;
+    }
+}
+
+TEST(skip, no_buffer)
+{
+    /* escapes are not copied to supplementary buffer */
+    const string sample = "{\"skip\":[\"" + string(100, 'a') + "\\n" + string(100, 'b') + "\\u0041\"], \"a\": 1}";
+    for (size_t n = 0; n <= sample.size(); ++n)
+    {
+        const vector<string> expected = {
+            to_string(PJ_TOK_MAP),
+            to_string(PJ_TOK_STR) + ":skip", to_string(PJ_TOK_KEY),
+            to_string(PJ_TOK_STR) + ":a", to_string(PJ_TOK_KEY), to_string(PJ_TOK_NUM) + ":1",
+            to_string(PJ_TOK_MAP_E),
+            to_string(PJ_END),
+        };
+        char buf[8];
+        EXPECT_EQ( expected, parse(sample, n, buf, sizeof(buf)) ) << n;
+    }
+}
+
+TEST(skip, array_items)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+
+    pj_feed(&parser, "[[1, 2], 3, {\"a\": 4}, 5]");
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_ARR, token.token_type );
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_NUM, token.token_type );
+    EXPECT_EQ( "3", string(token.str, token.len) );
+    EXPECT_EQ( -1, pj_skip_value(&parser) ) << "no value after 3";
+
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_MAP, token.token_type );
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( -1, pj_skip_value(&parser) ) << "key isn't a value";
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_KEY, token.token_type );
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_MAP_E, token.token_type );
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_NUM, token.token_type );
+    EXPECT_EQ( "5", string(token.str, token.len) );
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_ARR_E, token.token_type );
+}
+
+TEST(skip, many_strings)
+{
+    /* strings and comments within skipped value don't nest calls */
+    string sample = "[[";
+    for (size_t i = 0; i < (1 << 18); ++i) sample += "\"a\", /**/ ";
+    sample += "\"b\"], 1]";
+
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_feed(&parser, sample);
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_ARR, token.token_type );
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_NUM, token.token_type );
+    EXPECT_EQ( "1", string(token.str, token.len) );
+}
+
+TEST(skip, empty_array)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+
+    pj_feed(&parser, "[ ]");
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_ARR, token.token_type );
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+
+    array<pj_token, 2> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    EXPECT_EQ( PJ_TOK_ARR_E, tokens[0].token_type );
+    EXPECT_EQ( PJ_STARVING, tokens[1].token_type );
+}
+
+TEST(skip, errors)
+{
+    for (auto sample : { "[,1]", "{\"a\": }", "{\"a\": ,}" })
+    {
+        pj_parser parser;
+        pj_init(&parser, 0, 0);
+        pj_feed(&parser, sample, strlen(sample));
+
+        pj_token token;
+        do pj_poll(&parser, &token, 1);
+        while (token.token_type != PJ_TOK_KEY && token.token_type != PJ_TOK_ARR);
+        ASSERT_EQ( 0, pj_skip_value(&parser) ) << sample;
+
+        pj_poll(&parser, &token, 1);
+        EXPECT_EQ( PJ_ERR, token.token_type ) << sample;
+    }
+}
+
+TEST(skip, top_level)
+{
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+    pj_feed(&parser, "{\"a\": [1]}");
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    EXPECT_EQ( PJ_STARVING, token.token_type );
+    pj_feed_end(&parser);
+    pj_poll(&parser, &token, 1);
+    EXPECT_EQ( PJ_END, token.token_type );
+
+    /* scalar ends with document */
+    pj_init(&parser, 0, 0);
+    ASSERT_EQ( 0, pj_skip_value(&parser) );
+    pj_feed(&parser, "12");
+    pj_poll(&parser, &token, 1);
+    EXPECT_EQ( PJ_STARVING, token.token_type );
+    pj_feed_end(&parser);
+    pj_poll(&parser, &token, 1);
+    EXPECT_EQ( PJ_END, token.token_type );
+}
@@ -0,0 +1,150 @@
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pjson_testing.hpp"
+
+using namespace std;
+
+namespace {
+    /* dump of strings with sample fed by chunks of n bytes */
+    string parse(const string &sample, size_t n, int options = PJ_OPT_UTF8)
+    {
+        pj_parser parser;
+        vector<char> buf(4096);
+        pj_init(&parser, buf.data(), buf.size());
+        pj_set_options(&parser, options);
+
+        string dump;
+        for (size_t offset = 0;; offset += n) /* till PJ_END or PJ_ERR */
+        {
+            if (offset < sample.size()) pj_feed(&parser, sample.data() + offset, min(n, sample.size() - offset));
+            else pj_feed_end(&parser);
+            for (;;)
+            {
+                pj_token token;
+                pj_poll(&parser, &token, 1);
+                switch (token.token_type)
+                {
+                case PJ_STARVING: break;
+                case PJ_END: return dump;
+                case PJ_ERR: return dump + "!";
+                case PJ_OVERFLOW: return dump + "overflow";
+                case PJ_TOK_STR_PART: dump += string(token.str, token.len); continue;
+                case PJ_TOK_STR: dump += string(token.str, token.len) + " "; continue;
+                default: continue;
+                }
+                break;
+            }
+        }
+    }
+}
+
+TEST(utf8, valid)
+{
+    /* boundaries of 2, 3 and 4 bytes sequences (U+0080, U+07FF, U+0800,
+     * U+D7FF, U+E000, U+FFFF, U+10000, U+10FFFF)
+     */
+    const string chars = "\xc2\x80 \xdf\xbf \xe0\xa0\x80 \xed\x9f\xbf \xee\x80\x80 \xef\xbf\xbf "
+                         "\xf0\x90\x80\x80 \xf4\x8f\xbf\xbf";
+    const string sample = "{\"\xd0\xba\xd0\xbb\xd1\x8e\xd1\x87\": [\"" + chars + "\", \"a\\n\xc3\xa9\\u00e9\"]}";
+    const string expected = "\xd0\xba\xd0\xbb\xd1\x8e\xd1\x87 " + chars + " a\n\xc3\xa9\xc3\xa9 ";
+
+    for (size_t n = 1; n <= sample.size(); ++n)
+    {
+        ASSERT_EQ( expected, parse(sample, n) ) << "chunks of " << n;
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_UTF8 | PJ_OPT_STR_PARTS) ) << "chunks of " << n;
+        ASSERT_EQ( expected, parse(sample, n, PJ_OPT_UTF8 | PJ_OPT_CONTIGUOUS) ) << "chunks of " << n;
+    }
+}
+
+TEST(utf8, invalid)
+{
+    const char * const samples[] = {
+        "\x80", "\xbf", /* continuation without lead */
+        "\xc0\x80", "\xc1\xbf", /* overlong */
+        "\xe0\x80\x80", "\xe0\x9f\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf",
+        "\xed\xa0\x80", "\xed\xbf\xbf", /* surrogates */
+        "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff", /* above U+10FFFF */
+        "\xc3", "\xc3 ", "\xe2\x82", "\xf0\x9f\x98", "\xc3\xa9\xa9", /* cut */
+        "\xc3\\n", "\xe2\x82\\u0041",
+    };
+
+    for (const char *s : samples)
+    {
+        const string sample = string("[\"ok\", \"") + s + "\"]";
+        for (size_t n = 1; n <= sample.size(); ++n)
+        {
+            ASSERT_EQ( "ok !", parse(sample, n) ) << "chunks of " << n << " for " << sample;
+            ASSERT_EQ( "ok !", parse(sample, n, PJ_OPT_UTF8 | PJ_OPT_RAW_STR) ) << "chunks of " << n;
+        }
+        /* passes through without validation */
+        EXPECT_NE( "ok !", parse(sample, sample.size(), 0) ) << sample;
+    }
+
+    /* keys too */
+    EXPECT_EQ( "!", parse("{\"\xc3\": 1}", 64) );
+}
+
+TEST(utf8, long_runs)
+{
+    /* runs of multibyte chars longer than vector blocks */
+    string text;
+    for (size_t i = 0; i < 40; ++i) text += "\xd0\xbf\xe6\x96\x87\xf0\x9f\x98\x80 x";
+    const string sample = "[\"" + text + "\", \"" + text + "\\t" + text + "\"]";
+    const string expected = text + " " + text + "\t" + text + " ";
+
+    for (size_t n : { 1, 7, 31, 64, 1000, 4096 })
+        ASSERT_EQ( expected, parse(sample, n) ) << "chunks of " << n;
+
+    /* invalid byte anywhere in run */
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        string broken = text;
+        broken[i] = '\xff';
+        const string sample = "[\"" + broken + "\"]";
+        ASSERT_EQ( "!", parse(sample, sample.size()) ) << "at " << i;
+        ASSERT_EQ( "!", parse(sample, 13) ) << "at " << i;
+    }
+}
+
+TEST(utf8, skipped)
+{
+    /* skipped values aren't checked */
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_UTF8);
+    pj_feed(&parser, "[\"\xff\", \"ok\"]");
+
+    pj_token token;
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_ARR, token.token_type );
+    pj_skip_value(&parser);
+    pj_poll(&parser, &token, 1);
+    ASSERT_EQ( PJ_TOK_STR, token.token_type );
+    EXPECT_EQ( "ok", string(token.str, token.len) );
+}
+
+TEST(utf8, cut_then_number)
+{
+    /* tail of cut char doesn't leak into decoded number that follows */
+    const string first = "[\"\xc3", second = "\xa9\", 42]";
+    pj_parser parser;
+    pj_init(&parser, 0, 0);
+    pj_set_options(&parser, PJ_OPT_UTF8 | PJ_OPT_NUM_INT | PJ_OPT_CONTIGUOUS);
+
+    const string sample = first + second;
+    pj_feed(&parser, sample.data(), first.size());
+    array<pj_token, 4> tokens;
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_STARVING, tokens[1].token_type );
+
+    pj_feed(&parser, sample.data() + first.size(), second.size());
+    pj_poll(&parser, tokens.data(), tokens.size());
+    ASSERT_EQ( PJ_TOK_STR, tokens[0].token_type );
+    EXPECT_EQ( "\xc3\xa9", string(tokens[0].str, tokens[0].len) );
+    ASSERT_EQ( PJ_TOK_NUM, tokens[1].token_type );
+    ASSERT_TRUE( tokens[1].flags & PJ_NUM_INT );
+    EXPECT_EQ( 42, tokens[1].val.i );
+}
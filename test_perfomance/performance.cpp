@@ -1,4 +1,8 @@
 #include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
@@ -15,6 +19,51 @@ using namespace std;
 const size_t chunk_size = 4096;
 const size_t repeats = 10000;
 
+namespace {
+    /* pretty-printed document similar to what indenting producers send */
+    string indented_sample(size_t records)
+    {
+        string sample = "[\n";
+        for (size_t i = 0; i < records; ++i)
+        {
+            sample += "    {\n"
+                      "        \"id\": " + to_string(i) + ",\n"
+                      "        \"name\": \"record " + to_string(i) + "\",\n"
+                      "        \"tags\": [\n"
+                      "            \"alpha\",\n"
+                      "            \"beta\"\n"
+                      "        ],\n"
+                      "        \"active\": true\n"
+                      "    }";
+            sample += (i + 1 < records) ? ",\n" : "\n";
+        }
+        sample += "]\n";
+        return sample;
+    }
+
+    const size_t indented_records = 10000;
+    const size_t indented_repeats = 100;
+
+    /* GeoJSON-like array of coordinates */
+    string coordinates_sample(size_t points)
+    {
+        string sample = "[";
+        for (size_t i = 0; i < points; ++i)
+        {
+            char point[64];
+            snprintf(point, sizeof(point), "%s[%.6f,%.6f]", i ? "," : "",
+                     -180.0 + (i * 7919 % 360000) / 1000.0,
+                     -90.0 + (i * 104729 % 180000) / 1000.0);
+            sample += point;
+        }
+        sample += "]";
+        return sample;
+    }
+
+    const size_t coordinates_points = 100000;
+    const size_t coordinates_repeats = 20;
+}
+
 TEST(performance, measure_locale_count)
 {
     ifstream ifs(JSON_BIG_SAMPLE_FILE);
@@ -105,6 +154,477 @@ TEST(performance, measure_locale_pjson)
     }
 }
 
+TEST(performance, measure_indented_count)
+{
+    const string sample = indented_sample(indented_records);
+    size_t spaces = 0;
+    for (size_t n = 0; n < indented_repeats; ++n)
+    {
+        for (size_t offset = 0; offset < sample.size(); offset += chunk_size)
+        {
+            const char *chunk = sample.data() + offset;
+            const size_t sz = min(chunk_size, sample.size() - offset);
+            for (size_t i = 0; i < sz; ++i)
+            {
+                switch (chunk[i])
+                {
+                case '\t': case '\n': case '\r': case ' ':
+                    ++spaces;
+                    break;
+                default: ;
+                    // nothing
+                }
+            }
+        }
+    }
+    EXPECT_LT( 0, spaces );
+}
+
+namespace {
+    /* values of numbers are summed up if sum is given */
+    void measure_pjson(const string &sample, size_t repeats, int options = 0, double *sum = nullptr)
+    {
+        for (size_t n = 0; n < repeats; ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+            pj_set_options(&parser, options);
+
+            bool eof = false;
+            for (size_t offset = 0; !eof;)
+            {
+                const size_t sz = min(chunk_size, sample.size() - offset);
+                if (sz == 0)
+                {
+                    eof = true;
+                    pj_feed_end(&parser);
+                }
+                else
+                {
+                    pj_feed(&parser, sample.data() + offset, sz);
+                    offset += sz;
+                }
+                for (;;)
+                {
+                    array<pj_token, 128> tokens;
+                    pj_token terminal;
+                    const size_t count = pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal);
+                    if (sum != nullptr)
+                    {
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            if (tokens[i].token_type != PJ_TOK_NUM) continue;
+                            if (tokens[i].flags & PJ_NUM_DOUBLE)
+                            {
+                                *sum += tokens[i].val.d;
+                            }
+                            else
+                            {
+                                char text[64];
+                                const size_t len = min(tokens[i].len, sizeof(text) - 1);
+                                memcpy(text, tokens[i].str, len);
+                                text[len] = '\0';
+                                *sum += strtod(text, nullptr);
+                            }
+                        }
+                    }
+                    if (count == tokens.size()) continue;
+                    if (terminal.token_type == PJ_STARVING || terminal.token_type == PJ_END) break;
+                    FAIL() << "Unexpected terminal token " << terminal.token_type;
+                }
+            }
+        }
+    }
+}
+
+namespace {
+    /* same as measure_pjson() but with pj_poll_compact(); returns length of all strings */
+    size_t measure_pjson_compact(const string &sample, size_t repeats)
+    {
+        size_t total = 0;
+        for (size_t n = 0; n < repeats; ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+
+            bool eof = false;
+            for (size_t offset = 0; !eof;)
+            {
+                const size_t sz = min(chunk_size, sample.size() - offset);
+                if (sz == 0)
+                {
+                    eof = true;
+                    pj_feed_end(&parser);
+                }
+                else
+                {
+                    pj_feed(&parser, sample.data() + offset, sz);
+                    offset += sz;
+                }
+                for (bool starving = false, end = false; !starving && !end;)
+                {
+                    array<pj_ctoken, 128> tokens;
+                    pj_poll_compact(&parser, tokens.data(), tokens.size());
+                    for (size_t i = 0; i < tokens.size(); ++i)
+                    {
+                        const int type = PJ_CTOK_TYPE(&tokens[i]);
+                        if (type == PJ_STARVING)
+                        {
+                            starving = true;
+                            break;
+                        }
+                        else if (type == PJ_END)
+                        {
+                            end = true;
+                            break;
+                        }
+                        else if (type == PJ_ERR || type == PJ_OVERFLOW || type == PJ_CTOK_LONG)
+                        {
+                            ADD_FAILURE() << "Unexpected terminal token " << type;
+                            return total;
+                        }
+                        else if (type == PJ_TOK_STR)
+                        {
+                            total += PJ_CTOK_LEN(&tokens[i]);
+                        }
+                    }
+                }
+            }
+        }
+        return total;
+    }
+}
+
+namespace {
+    /* pj_poll_soa() with filter over types; returns number of strings */
+    size_t measure_pjson_soa(const string &sample, size_t repeats)
+    {
+        size_t total = 0;
+        for (size_t n = 0; n < repeats; ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+
+            bool eof = false;
+            for (size_t offset = 0; !eof;)
+            {
+                const size_t sz = min(chunk_size, sample.size() - offset);
+                if (sz == 0)
+                {
+                    eof = true;
+                    pj_feed_end(&parser);
+                }
+                else
+                {
+                    pj_feed(&parser, sample.data() + offset, sz);
+                    offset += sz;
+                }
+                for (bool starving = false, end = false; !starving && !end;)
+                {
+                    const size_t batch = 128;
+                    uint8_t types[batch];
+                    uint32_t offsets[batch], lens[batch];
+                    pj_poll_soa(&parser, types, offsets, lens, batch);
+
+                    size_t count = 0;
+                    while (count < batch && types[count] >= PJ_TOK_NULL && types[count] != PJ_CTOK_LONG)
+                        ++count;
+                    for (size_t i = 0; i < count; ++i) total += (types[i] == PJ_TOK_STR);
+                    if (count == batch) continue;
+
+                    if (types[count] == PJ_STARVING) starving = true;
+                    else if (types[count] == PJ_END) end = true;
+                    else
+                    {
+                        ADD_FAILURE() << "Unexpected terminal token " << (int)types[count];
+                        return total;
+                    }
+                }
+            }
+        }
+        return total;
+    }
+}
+
+TEST(performance, measure_indented_pjson)
+{
+    measure_pjson(indented_sample(indented_records), indented_repeats);
+}
+
+TEST(performance, measure_indented_compact)
+{
+    EXPECT_LT( 0, measure_pjson_compact(indented_sample(indented_records), indented_repeats) );
+}
+
+TEST(performance, measure_indented_soa)
+{
+    EXPECT_LT( 0, measure_pjson_soa(indented_sample(indented_records), indented_repeats) );
+}
+
+TEST(performance, measure_coordinates_pjson)
+{
+    measure_pjson(coordinates_sample(coordinates_points), coordinates_repeats);
+}
+
+TEST(performance, measure_coordinates_strtod)
+{
+    double sum = 0;
+    measure_pjson(coordinates_sample(coordinates_points), coordinates_repeats, 0, &sum);
+    EXPECT_NE( 0, sum );
+}
+
+TEST(performance, measure_coordinates_double)
+{
+    double sum = 0, expected = 0;
+    const string sample = coordinates_sample(coordinates_points);
+    measure_pjson(sample, coordinates_repeats, PJ_OPT_NUM_DOUBLE, &sum);
+    measure_pjson(sample, 1, 0, &expected);
+    EXPECT_NEAR( expected * coordinates_repeats, sum, 1e-3 );
+}
+
+namespace {
+    const char * const record_keys[] = {
+        "id", "type", "name", "email", "status", "score", "tags", "owner",
+        "created_at", "created_by", "updated_at", "updated_by",
+        "deleted_at", "deleted_by", "user_id", "user_name",
+        "parent_id", "parent_type", "item_id", "item_type",
+        "price", "currency", "quantity", "comment"
+    };
+    const size_t record_keys_count = sizeof(record_keys) / sizeof(record_keys[0]);
+
+    /* array of flat objects with keys above */
+    string records_sample(size_t records)
+    {
+        string sample = "[";
+        for (size_t i = 0; i < records; ++i)
+        {
+            sample += i ? "," : "";
+            sample += "{";
+            for (size_t k = 0; k < record_keys_count; ++k)
+            {
+                sample += k ? "," : "";
+                sample += "\"" + string(record_keys[(k + i) % record_keys_count]) + "\":" + to_string(k);
+            }
+            sample += "}";
+        }
+        sample += "]";
+        return sample;
+    }
+
+    const size_t records_count = 20000;
+    const size_t records_repeats = 20;
+
+    enum dispatch { no_dispatch, strcmp_dispatch, keys_dispatch, fused_dispatch };
+
+    /* dispatch keys either with strcmp() chain or with pj_set_keys() */
+    size_t measure_keys(const string &sample, size_t repeats, dispatch how)
+    {
+        size_t hits = 0;
+        pj_keys keys;
+        for (size_t n = 0; n < repeats; ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+            if (how >= keys_dispatch) pj_set_keys(&parser, &keys, record_keys, record_keys_count);
+            if (how == fused_dispatch) pj_set_options(&parser, PJ_OPT_FUSED_KEY);
+
+            bool eof = false;
+            for (size_t offset = 0; !eof;)
+            {
+                const size_t sz = min(chunk_size, sample.size() - offset);
+                if (sz == 0)
+                {
+                    eof = true;
+                    pj_feed_end(&parser);
+                }
+                else
+                {
+                    pj_feed(&parser, sample.data() + offset, sz);
+                    offset += sz;
+                }
+                for (bool starving = false, end = false; !starving && !end;)
+                {
+                    array<pj_token, 128> tokens;
+                    pj_poll(&parser, tokens.data(), tokens.size());
+                    for (size_t i = 0; i < tokens.size(); ++i)
+                    {
+                        const pj_token &token = tokens[i];
+                        if (token.token_type == PJ_STARVING) { starving = true; break; }
+                        if (token.token_type == PJ_END) { end = true; break; }
+                        if (how == fused_dispatch)
+                        {
+                            if (token.token_type == PJ_TOK_KEY) hits += token.val.key;
+                            continue;
+                        }
+                        if (token.token_type != PJ_TOK_STR || how == no_dispatch) continue;
+                        if (how == keys_dispatch)
+                        {
+                            if (token.flags & PJ_STR_KEY) hits += token.val.key;
+                            continue;
+                        }
+                        for (size_t k = 0; k < record_keys_count; ++k)
+                        {
+                            if (strlen(record_keys[k]) == token.len &&
+                                memcmp(record_keys[k], token.str, token.len) == 0)
+                            {
+                                hits += k;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return hits;
+    }
+}
+
+TEST(performance, measure_records_pjson)
+{
+    measure_keys(records_sample(records_count), records_repeats, no_dispatch);
+}
+
+TEST(performance, measure_records_strcmp)
+{
+    EXPECT_LT( 0, measure_keys(records_sample(records_count), records_repeats, strcmp_dispatch) );
+}
+
+TEST(performance, measure_records_keys)
+{
+    EXPECT_LT( 0, measure_keys(records_sample(records_count), records_repeats, keys_dispatch) );
+}
+
+TEST(performance, measure_records_fused)
+{
+    EXPECT_LT( 0, measure_keys(records_sample(records_count), records_repeats, fused_dispatch) );
+}
+
+namespace {
+    /* single string of len bytes with escape every 64 bytes */
+    string long_string_sample(size_t len)
+    {
+        string sample = "[\"";
+        for (size_t i = 0; i < len; i += 64) sample += string(62, 'x') + "\\n";
+        sample += "\"]";
+        return sample;
+    }
+
+    const size_t long_string_len = 4 << 20;
+    const size_t long_string_chunk = 512;
+    const size_t long_string_repeats = 10;
+
+    /* buffer is doubled on each PJ_OVERFLOW or grows by step if it's given */
+    void measure_long_string(size_t step)
+    {
+        const string sample = long_string_sample(long_string_len);
+        for (size_t n = 0; n < long_string_repeats; ++n)
+        {
+            pj_parser parser;
+            vector<char> buf(256);
+            pj_init(&parser, buf.data(), buf.size());
+
+            size_t total = 0;
+            for (size_t offset = 0; offset <= sample.size(); offset += long_string_chunk)
+            {
+                if (offset < sample.size())
+                    pj_feed(&parser, sample.data() + offset, min(long_string_chunk, sample.size() - offset));
+                else pj_feed_end(&parser);
+                for (bool starving = false; !starving;)
+                {
+                    array<pj_token, 16> tokens;
+                    pj_token terminal;
+                    const size_t count = pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal);
+                    for (size_t i = 0; i < count; ++i)
+                        if (tokens[i].token_type == PJ_TOK_STR) total += tokens[i].len;
+                    if (count == tokens.size()) continue;
+                    if (terminal.token_type == PJ_OVERFLOW)
+                    {
+                        vector<char> bigger(max(terminal.len, step > 0 ? buf.size() + step : 2 * buf.size()));
+                        pj_realloc(&parser, bigger.data(), bigger.size());
+                        buf.swap(bigger);
+                        continue;
+                    }
+                    ASSERT_NE( PJ_ERR, terminal.token_type );
+                    starving = true;
+                }
+            }
+            EXPECT_EQ( long_string_len / 64 * 63, total );
+        }
+    }
+}
+
+TEST(performance, measure_long_string)
+{
+    measure_long_string(0);
+}
+
+TEST(performance, measure_long_string_fixed_growth)
+{
+    measure_long_string(64 << 10);
+}
+
+namespace {
+    /* whole document in memory either with pj_feed(), pj_feed_end() and
+     * pj_poll_n() or with pj_parse_buffer(); returns number of tokens
+     */
+    size_t measure_whole(const string &sample, size_t repeats, bool parse_buffer, int options = 0)
+    {
+        size_t total = 0;
+        for (size_t n = 0; n < repeats; ++n)
+        {
+            pj_parser parser;
+            char buf[256];
+            pj_init(&parser, buf, sizeof(buf));
+            pj_set_options(&parser, options);
+            if (!parse_buffer) pj_feed(&parser, sample);
+
+            for (const char *doc = sample.data();; doc = nullptr)
+            {
+                array<pj_token, 128> tokens;
+                pj_token terminal;
+                const size_t count = parse_buffer ?
+                    pj_parse_buffer(&parser, doc, sample.size(), tokens.data(), tokens.size()) :
+                    pj_poll_n(&parser, tokens.data(), tokens.size(), &terminal);
+                total += count;
+                if (count == tokens.size()) continue;
+                if (parse_buffer) terminal = tokens[count];
+                if (terminal.token_type == PJ_STARVING)
+                {
+                    pj_feed_end(&parser);
+                    continue;
+                }
+                EXPECT_EQ( PJ_END, terminal.token_type );
+                break;
+            }
+        }
+        return total;
+    }
+}
+
+TEST(performance, measure_indented_whole)
+{
+    EXPECT_LT( 0, measure_whole(indented_sample(indented_records), indented_repeats, false) );
+}
+
+TEST(performance, measure_indented_parse_buffer)
+{
+    EXPECT_LT( 0, measure_whole(indented_sample(indented_records), indented_repeats, true) );
+}
+
+TEST(performance, measure_records_whole)
+{
+    EXPECT_LT( 0, measure_whole(records_sample(records_count), records_repeats, false, PJ_OPT_FUSED_KEY) );
+}
+
+TEST(performance, measure_records_parse_buffer)
+{
+    EXPECT_LT( 0, measure_whole(records_sample(records_count), records_repeats, true, PJ_OPT_FUSED_KEY) );
+}
+
 #ifdef HAVE_YAJL
 TEST(performance, measure_locale_yajl_dummy)
 {